@@ -0,0 +1,215 @@
+// Benchmarks of operator*, inverse(), determinant(), eliminate() and
+// transpose() for Matrix<T, N, N> and Matrix<T>, with T of int, double,
+// Residue and Rational. It is a program on its own, C++11 for <chrono>:
+//   g++ -std=c++11 -O2 -march=native LinearAlgebra.cc -o bench
+//   ./bench [largest N of Matrix<T>, 1024 by default] > release.tsv
+// Every case is a tab-separated line, so two runs diff or join on the
+// first four columns:
+//   matrix type op n ns gops gbps allocs bytes
+// ns is a call, gops the arithmetic operations (GFLOP/s for double) and
+// gbps the least memory traffic (reading the operands and writing the
+// result once) a second, allocs and bytes are what a call allocates.
+// int only multiplies and transposes, it has no field operations, and
+// Rational<long long> eliminates up to 8 x 8, where nothing overflows.
+
+#if __cplusplus < 201103L
+#error "C++11 is needed for <chrono>"
+#endif  // __cplusplus < 201103L
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+#include "../HighPrecision/Rational.hh"
+#include "../LinearAlgebra/Matrix.hh"
+#include "../LinearAlgebra/VariableMatrix.hh"
+#include "../NumberTheory/Residue.hh"
+
+namespace {
+
+size_t allocations = 0, allocated = 0;
+
+}  // namespace
+
+// Every allocation goes through these, to be counted.
+void *operator new(size_t size) {
+  ++allocations, allocated += size;
+  if (void *p = std::malloc(size ? size : 1)) return p;
+  throw std::bad_alloc();
+}
+
+void *operator new[](size_t size) {
+  return ::operator new(size);
+}
+
+void operator delete(void *p) noexcept {
+  std::free(p);
+}
+
+void operator delete[](void *p) noexcept {
+  std::free(p);
+}
+
+void operator delete(void *p, size_t) noexcept {
+  std::free(p);
+}
+
+void operator delete[](void *p, size_t) noexcept {
+  std::free(p);
+}
+
+namespace {
+
+typedef Residue<long long, 998244353> Modular;
+typedef Rational<long long> Fraction;
+
+// Keeps the compiler from dropping what is computed into x.
+template <typename T> void
+keep(const T &x) {
+#if defined(__GNUC__)
+  asm volatile("" : : "g"(&x) : "memory");
+#else
+  static const void *volatile sink;
+  sink = &x;
+#endif
+}
+
+// The name, and the largest N for the eliminations (0 for none).
+template <typename T> struct Traits;
+
+template <> struct Traits<int> {
+  static const char *name() { return "int"; }
+  static const size_t eliminate = 0;
+};
+
+template <> struct Traits<double> {
+  static const char *name() { return "double"; }
+  static const size_t eliminate = ~size_t(0);
+};
+
+template <> struct Traits<Modular> {
+  static const char *name() { return "residue"; }
+  static const size_t eliminate = ~size_t(0);
+};
+
+template <> struct Traits<Fraction> {
+  static const char *name() { return "rational"; }
+  static const size_t eliminate = 8;
+};
+
+// 0 or 1, with n on the diagonal: nonsingular, and small determinants.
+template <typename M> void
+fill(M &matrix, size_t n, unsigned seed) {
+  for (size_t r = 0; r != n; ++r)
+    for (size_t c = 0; c != n; ++c) {
+      seed = seed * 1103515245 + 12345;
+      matrix[r][c] = static_cast<int>(r == c ? n : seed >> 16 & 1);
+    }
+}
+
+// Calls run until some 0.2 seconds have passed, then prints its line.
+template <typename T, typename Run> void
+measure(const char *matrix, const char *op, size_t n, double ops,
+        double bytes, Run run) {
+  typedef std::chrono::steady_clock Clock;
+  const size_t allocationsBefore = allocations, allocatedBefore = allocated;
+  const Clock::time_point begin = Clock::now();
+  size_t calls = 0;
+  double seconds = 0;
+  do {
+    run();
+    ++calls;
+    seconds = std::chrono::duration<double>(Clock::now() - begin).count();
+  } while (seconds < 0.2);
+  const double ns = seconds * 1e9 / calls;
+  std::printf("%s\t%s\t%s\t%zu\t%.1f\t%.3f\t%.3f\t%.1f\t%.0f\n",
+              matrix, Traits<T>::name(), op, n, ns, ops / ns, bytes / ns,
+              double(allocations - allocationsBefore) / calls,
+              double(allocated - allocatedBefore) / calls);
+  std::fflush(stdout);
+}
+
+template <typename T, size_t N> void
+fixed() {
+  typedef Matrix<T, N, N> M;
+  const double n = N, size = n * n * sizeof(T);
+  M a, b, c;
+  fill(a, N, 1), fill(b, N, 2);
+  measure<T>("fixed", "multiply", N, 2 * n * n * n, 3 * size, [&] {
+    c = a * b;
+    keep(c);
+  });
+  measure<T>("fixed", "transpose", N, 0, 2 * size, [&] {
+    c.transpose();
+    keep(c);
+  });
+  if (N > Traits<T>::eliminate) return;
+  measure<T>("fixed", "inverse", N, 2 * n * n * n, 2 * size, [&] {
+    c = a;
+    keep(c.inverse());
+  });
+  measure<T>("fixed", "determinant", N, 2 * n * n * n / 3, size, [&] {
+    const T d = a.determinant();
+    keep(d);
+  });
+  measure<T>("fixed", "eliminate", N, n * n * n, 2 * size, [&] {
+    c = a;
+    keep(c.eliminate());
+  });
+}
+
+template <typename T> void
+variable(size_t n) {
+  typedef Matrix<T> M;
+  const double size = double(n) * n * sizeof(T), cube = double(n) * n * n;
+  M a(n, n), b(n, n), c(n, n);
+  fill(a, n, 1), fill(b, n, 2);
+  measure<T>("variable", "multiply", n, 2 * cube, 3 * size, [&] {
+    c = a * b;
+    keep(c);
+  });
+  measure<T>("variable", "transpose", n, 0, 2 * size, [&] {
+    c.transpose();
+    keep(c);
+  });
+  if (n > Traits<T>::eliminate) return;
+  measure<T>("variable", "inverse", n, 2 * cube, 2 * size, [&] {
+    c = a;
+    keep(c.inverse());
+  });
+  measure<T>("variable", "determinant", n, 2 * cube / 3, size, [&] {
+    const T d = a.determinant();
+    keep(d);
+  });
+  measure<T>("variable", "eliminate", n, cube, 2 * size, [&] {
+    c = a;
+    keep(c.eliminate());
+  });
+}
+
+template <typename T> void
+all(size_t largest) {
+  fixed<T, 2>();
+  fixed<T, 3>();
+  fixed<T, 4>();
+  fixed<T, 8>();
+  fixed<T, 16>();
+  fixed<T, 32>();
+  fixed<T, 64>();
+  // Rational is far too slow for the large ones.
+  const size_t cap = Traits<T>::eliminate == 8 ? 64 : largest;
+  for (size_t n = 4; n <= largest && n <= cap; n *= 4) variable<T>(n);
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  const size_t largest = argc > 1 ? std::strtoul(argv[1], NULL, 10) : 1024;
+  std::printf("#matrix\ttype\top\tn\tns\tgops\tgbps\tallocs\tbytes\n");
+  all<int>(largest);
+  all<double>(largest);
+  all<Modular>(largest);
+  all<Fraction>(largest);
+  return 0;
+}
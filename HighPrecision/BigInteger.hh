@@ -7,6 +7,8 @@
 #include <stdint.h>
 #include <vector>
 
+#include "../NumberTheory/NTT.hh"
+
 // Arbitrary precision integer class.
 // Each cell of std::vector save 32 bits.
 class BigInteger {
@@ -43,8 +45,6 @@ class BigInteger {
   Container value;
   bool negative;
   const static uint64_t base;
-  const static uint64_t mod;
-  const static uint64_t root;
 
   // Time complexity of converting between bases is O(log²n).
   void getDec_(std::istream &);
@@ -55,21 +55,20 @@ class BigInteger {
   void putOct_(std::ostream &) const;
   void getBin_(std::istream &);
   void putBin_(std::ostream &) const;
-  // Helper function for operator*=, /= and %=
-  static uint64_t modpow_(uint64_t, uint64_t);
-  static uint64_t modinv_(int64_t, int64_t);
-  // Number Theory Transform.
-  void NTT_(uint64_t, bool);
+  // Helper functions for operator*=: the limbs of the product, and their
+  // convolution modulo P.
+  static void multiplySchoolbook_(const Container &, const Container &,
+                                  Container &);
+  static void multiplyNTT_(const Container &, const Container &,
+                           Container &);
+  template <uint32_t P> static void
+  convolve_(const Container &, const Container &,
+            std::vector<Residue<uint32_t, P> > &);
 
   void eliminateNegativeZero_();
   void trimLeadingZeros_();
 };
 const uint64_t BigInteger::base = static_cast<uint64_t>(1) << 31;
-// With BigInteger::mod = (1 << 30) * 3 + 1,
-// BigInteger can proccess 4GB data,
-// which is fully adequate for ACM-ICPC.
-const uint64_t BigInteger::mod = (static_cast<uint64_t>(1) << 59) * 9 + 1;
-const uint64_t BigInteger::root = 5;
 
 BigInteger::BigInteger()
     : value(1, 0), negative(false) {
@@ -297,24 +296,17 @@ BigInteger operator-(const BigInteger &lhs, const BigInteger &rhs) {
   return result -= rhs;
 }
 
-// TODO: run benchmark to determine the critical section where
-// O(|I|²) multiply is less or as fast as O(|I|log|I|) one.
-// broken, FIXME
+// O(|I|²) below 32 limbs or so, O(|I|log|I|) with NTT above.
 BigInteger &operator*=(BigInteger &lhs, const BigInteger &rhs) {
-  return lhs;
-  uint64_t logN = 0;
+  BigInteger::Container product;
+  if (std::min(lhs.value.size(), rhs.value.size()) <= 32
+      || !NTT<998244353u>::fits(lhs.value.size() + rhs.value.size() - 1))
+    BigInteger::multiplySchoolbook_(lhs.value, rhs.value, product);
+  else
+    BigInteger::multiplyNTT_(lhs.value, rhs.value, product);
+  lhs.value.swap(product);
   lhs.negative ^= rhs.negative;
-  BigInteger &l = lhs, r = rhs;
-  const size_t size = std::max(lhs.value.size(), rhs.value.size());
-  while (static_cast<size_t>(1) << logN < size << 1) ++logN;
-  const size_t n = static_cast<size_t>(1) << logN;
-  l.value.resize(n); l.NTT_(logN, false);
-  r.value.resize(n); r.NTT_(logN, false);
-  for (size_t i = 0; i != n; ++i)
-    l.value[i] = l.value[i] * r.value[i];
-  // TODO: lazy evaluation, optimize for continually multiplying.
-  l.NTT_(logN, true);
-  l.trimLeadingZeros_();
+  lhs.trimLeadingZeros_();
   return lhs;
 }
 
@@ -468,67 +460,65 @@ void BigInteger::putDec_(std::ostream &os) const {
   }
 }
 
-uint64_t BigInteger::modpow_(uint64_t base, uint64_t expo) {
-  uint64_t retn = 1;
-  do {
-    if (expo & 1) retn = retn * base % BigInteger::mod;
-    if (expo ^ 1) base = base * base % BigInteger::mod;
-  } while (expo >>= 1);
-  return retn;
-}
-
-uint64_t BigInteger::modinv_(int64_t m, int64_t n) {
-  int64_t x = 0, y = 1, xp = 1, yp = 0, xt, yt, mod = n;
-  for (int64_t r = m % n, q = m / n; r; ) {
-    xt = xp - q * x, xp = x, x = xt;
-    yt = yp - q * y, yp = y, y = yt;
-    m = n, n = r, r = m % n, q = m / n;
-  }
-  return x + mod;
-}
-
-void BigInteger::NTT_(uint64_t logN, bool inverse) {
-  // Initialization of unit roots w.
-  const uint64_t n = this->value.size();
-  const uint64_t g = modpow_(root, mod >> logN);
-  const uint64_t gh = g >> 32, gl = g & 0xffffffff;
-  const uint64_t i64maxmod = -BigInteger::mod;
-  uint64_t *const w = new uint64_t[n]; w[0] = 1;
-  for (size_t i = 1; i != n; ++i) {
-//    w[i] = w[i - 1] * g % mod;
-    const uint64_t wh = w[i] >> 32, wl = w[i] & 0xffffffff;
-    const uint64_t m = wh * gl + wl * gh;
-    const uint64_t h = wh * gh + (m >> 32);
-    const uint64_t l = wl * gl + (m & 0xffffffff);
-  }
-  if (inverse) {
-    std::reverse(w + 1, w + n);
-    const uint64_t inv = modinv_(n, mod);
-    for (size_t i = 0; i != n; ++i) {
-      this->value[i] = this->value[i] * inv % BigInteger::mod;
+void BigInteger::multiplySchoolbook_(const Container &lhs,
+                                     const Container &rhs,
+                                     Container &product) {
+  product.assign(lhs.size() + rhs.size(), 0);
+  for (size_t i = 0; i != lhs.size(); ++i) {
+    uint64_t carry = 0;
+    for (size_t j = 0; j != rhs.size(); ++j) {
+      // Below 2^62 + 2^32.
+      carry += lhs[i] * rhs[j] + product[i + j];
+      product[i + j] = carry % BigInteger::base;
+      carry /= BigInteger::base;
     }
+    product[i + rhs.size()] = carry;
   }
-  // Main part of transforming.
-  for (size_t i = 0, j = 0; i != n; ++i) {
-    if (i > j) std::swap(this->value[i], this->value[j]);
-    for (size_t k = n; j < k; j ^= k) k >>= 1;
-  }
-  for (size_t i = 1, I = n >> 1; I; i <<= 1, I >>= 1)
-    for (size_t j = 0; j != n; j += i << 1)
-      for (size_t k = 0; k != i; ++k) {
-        const uint64_t z = this->value[i + j + k] * w[I * k] % mod;
-        if (this->value[j + k] < z)
-          this->value[i + j + k] = this->value[j + k] - z;
-        else this->value[i + j + k] = this->value[j + k] - z;
-        if (this->value[j + k] + z < mod) this->value[j + k] += z;
-        else this->value[j + k] = this->value[j + k] + z - mod;
-      }
-  if (inverse) {
-    const uint64_t inv = modinv_(n, mod);
-    for (size_t i = 0; i != n; ++i)
-      this->value[i] = this->value[i] * inv;
+}
+
+// The coefficients of the product are below min(|lhs|, |rhs|) * 2^62, so
+// three primes (about 2^86) take up to 2^23 limbs, which is as long as a
+// transform modulo 998244353 goes anyway.
+void BigInteger::multiplyNTT_(const Container &lhs, const Container &rhs,
+                              Container &product) {
+  const uint64_t P1 = 998244353u, P2 = 167772161u, P3 = 469762049u;
+  std::vector<Residue<uint32_t, 998244353u> > z1;
+  std::vector<Residue<uint32_t, 167772161u> > z2;
+  std::vector<Residue<uint32_t, 469762049u> > z3;
+  convolve_(lhs, rhs, z1);
+  convolve_(lhs, rhs, z2);
+  convolve_(lhs, rhs, z3);
+  // Garner's algorithm: x = x12 + P1 P2 t with x12 < P1 P2. P1 P2 t is
+  // split at 2^31 so that the carries stay below 2^62.
+  static const uint64_t inverse12 = nttModPower_(P1 % P2, P2 - 2, P2);
+  static const uint64_t inverse123 = nttModPower_(P1 * P2 % P3, P3 - 2, P3);
+  const uint64_t p12 = P1 * P2, mask = BigInteger::base - 1;
+  product.assign(z1.size() + 1, 0);
+  uint64_t carry = 0;
+  for (size_t i = 0; i != z1.size(); ++i) {
+    const uint64_t r1 = z1[i].residue(), r2 = z2[i].residue();
+    const uint64_t r3 = z3[i].residue();
+    const uint64_t x12 = r1 + P1 * ((r2 + P2 - r1 % P2) % P2 * inverse12 % P2);
+    const uint64_t t = (r3 + P3 - x12 % P3) % P3 * inverse123 % P3;
+    carry += x12 + (p12 & mask) * t;
+    product[i] = carry & mask;
+    carry = (carry >> 31) + (p12 >> 31) * t;
   }
-  delete[] w;
+  product.back() = carry;
+}
+
+template <uint32_t P>
+void BigInteger::convolve_(const Container &lhs, const Container &rhs,
+                           std::vector<Residue<uint32_t, P> > &product) {
+  typedef Residue<uint32_t, P> Z;
+  std::vector<Z> x(lhs.size()), y(&lhs == &rhs ? 0 : rhs.size());
+  for (size_t i = 0; i != x.size(); ++i)
+    x[i] = Z(static_cast<uint32_t>(lhs[i] % P));
+  for (size_t i = 0; i != y.size(); ++i)
+    y[i] = Z(static_cast<uint32_t>(rhs[i] % P));
+  product.resize(lhs.size() + rhs.size() - 1);
+  NTT<P>::convolve(&x[0], x.size(), y.empty() ? &x[0] : &y[0], rhs.size(),
+                   &product[0]);
 }
 
 void BigInteger::eliminateNegativeZero_() {
@@ -2,23 +2,9 @@
 
 #include <utility>  // std::pair, std::make_pair
 #include <ostream>  // std::ostream
+#include <stdexcept>
 
-template <typename T>
-T gcd(T m, T n) {
-  if (!m || !n) return m | n;
-  if (m < 0) m = -m;
-  if (n < 0) n = -n;
-  int p = 0;
-  while (!(m & 1) && !(n & 1))
-    m >>= 1, n >>= 1, ++p;
-  while (n) {
-    while (!(m & 1)) m >>= 1;
-    while (!(n & 1)) n >>= 1;
-    if (m >= n) std::swap(m, n);
-    n = (n - m) >> 1;
-  }
-  return m << p;
-}
+#include "../NumberTheory/Euclid.hh"
 
 template <typename T> class Rational;
 template <typename T> std::ostream &
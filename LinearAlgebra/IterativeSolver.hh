@@ -0,0 +1,264 @@
+#pragma once
+
+#include <cmath>  // std::sqrt
+#include <stdexcept>
+#include <vector>
+
+#include "SparseMatrix.hh"
+#include "VariableMatrix.hh"
+#include "Vector.hh"
+
+// Iterative solvers of A x = b for floating-point types, where inverse()
+// of Matrix<T> would take O(n^3). A is a Matrix<T>, a SparseMatrix<T> or
+// anything callable as a(x, y) writing A x to y (std::vector<T>).
+// x is the initial guess on entry and the solution on return.
+// They stop when |b - A x| <= tolerance * |b| or after maxIterations;
+// pass IdentityPreconditioner to set those without preconditioning.
+
+struct IterativeStats {
+  size_t iterations;
+  // |b - A x| / |b| at last.
+  double residual;
+  bool converged;
+};
+
+template <typename T, typename Operator> void
+applyOperator_(const Operator &a, const std::vector<T> &x, std::vector<T> &y) {
+  a(x, y);
+}
+
+template <typename T> void
+applyOperator_(const Matrix<T> &a, const std::vector<T> &x,
+               std::vector<T> &y) {
+  if (a.row() != y.size() || a.col() != x.size())
+    throw std::invalid_argument("applyOperator_");
+  for (size_t r = 0; r != a.row(); ++r)
+    y[r] = static_cast<T>(vectorDot_(a[r], x.empty() ? NULL : &x[0], a.col()));
+}
+
+template <typename T> void
+applyOperator_(const SparseMatrix<T> &a, const std::vector<T> &x,
+               std::vector<T> &y) {
+  if (a.row() != y.size() || a.col() != x.size())
+    throw std::invalid_argument("applyOperator_");
+  if (!y.empty()) a.multiply(x.empty() ? NULL : &x[0], &y[0]);
+}
+
+// With the kernels of Vector.hh, which keep four partial sums.
+template <typename T> T
+dot_(const std::vector<T> &x, const std::vector<T> &y) {
+  if (x.empty()) return T(0);
+  return static_cast<T>(vectorDot_(&x[0], &y[0], x.size()));
+}
+
+// z = r, i.e. no preconditioning.
+template <typename T>
+class IdentityPreconditioner {
+ public:
+  void operator()(const std::vector<T> &r, std::vector<T> &z) const {
+    z = r;
+  }
+};
+
+// z = r / diag(A), cheap and good for diagonally dominant A.
+// Throws std::invalid_argument if a diagonal element is zero.
+template <typename T>
+class JacobiPreconditioner {
+ public:
+  explicit JacobiPreconditioner(const Matrix<T> &);
+  explicit JacobiPreconditioner(const SparseMatrix<T> &);
+
+  void operator()(const std::vector<T> &, std::vector<T> &) const;
+
+ private:
+  std::vector<T> inverse_;
+};
+
+template <typename T>
+JacobiPreconditioner<T>::JacobiPreconditioner(const Matrix<T> &a)
+    : inverse_(a.row()) {
+  for (size_t i = 0; i != a.row(); ++i) {
+    if (a[i][i] == T())
+      throw std::invalid_argument("JacobiPreconditioner");
+    this->inverse_[i] = T(1) / a[i][i];
+  }
+}
+
+template <typename T>
+JacobiPreconditioner<T>::JacobiPreconditioner(const SparseMatrix<T> &a)
+    : inverse_(a.row()) {
+  for (size_t i = 0; i != a.row(); ++i) {
+    const T d = a.at(i, i);
+    if (d == T()) throw std::invalid_argument("JacobiPreconditioner");
+    this->inverse_[i] = T(1) / d;
+  }
+}
+
+template <typename T> void
+JacobiPreconditioner<T>::operator()(const std::vector<T> &r,
+                                    std::vector<T> &z) const {
+  for (size_t i = 0; i != r.size(); ++i) z[i] = r[i] * this->inverse_[i];
+}
+
+// Incomplete LU without fill-in: L U = A on the nonzeros of A, with the
+// unit diagonal of L implied. z = U^-1 L^-1 r.
+// Throws std::invalid_argument if a pivot is zero.
+template <typename T>
+class Ilu0Preconditioner {
+ public:
+  explicit Ilu0Preconditioner(const SparseMatrix<T> &);
+
+  void operator()(const std::vector<T> &, std::vector<T> &) const;
+
+ private:
+  std::vector<size_t> rowBegin_, colIndex_, diagonal_;
+  std::vector<T> values_;
+};
+
+template <typename T>
+Ilu0Preconditioner<T>::Ilu0Preconditioner(const SparseMatrix<T> &a)
+    : rowBegin_(a.rowBegin(), a.rowBegin() + a.row() + 1),
+      colIndex_(a.colIndex(), a.colIndex() + a.nonZeros()),
+      diagonal_(a.row()), values_(a.values(), a.values() + a.nonZeros()) {
+  const size_t n = a.row(), none = ~static_cast<size_t>(0);
+  if (n != a.col()) throw std::invalid_argument("Ilu0Preconditioner");
+  // position[c] is where column c is in the current row.
+  std::vector<size_t> position(n, none);
+  for (size_t i = 0; i != n; ++i) {
+    const size_t begin = this->rowBegin_[i], end = this->rowBegin_[i + 1];
+    for (size_t p = begin; p != end; ++p) position[this->colIndex_[p]] = p;
+    if (position[i] == none)
+      throw std::invalid_argument("Ilu0Preconditioner");
+    for (size_t p = begin; p != end && this->colIndex_[p] < i; ++p) {
+      const size_t k = this->colIndex_[p];
+      const T f = this->values_[p] /= this->values_[this->diagonal_[k]];
+      for (size_t q = this->diagonal_[k] + 1; q != this->rowBegin_[k + 1]; ++q)
+        if (position[this->colIndex_[q]] != none)
+          this->values_[position[this->colIndex_[q]]] -= f * this->values_[q];
+    }
+    this->diagonal_[i] = position[i];
+    if (this->values_[position[i]] == T())
+      throw std::invalid_argument("Ilu0Preconditioner");
+    for (size_t p = begin; p != end; ++p) position[this->colIndex_[p]] = none;
+  }
+}
+
+template <typename T> void
+Ilu0Preconditioner<T>::operator()(const std::vector<T> &r,
+                                  std::vector<T> &z) const {
+  const size_t n = r.size();
+  for (size_t i = 0; i != n; ++i) {
+    T sum = r[i];
+    for (size_t p = this->rowBegin_[i]; p != this->diagonal_[i]; ++p)
+      sum -= this->values_[p] * z[this->colIndex_[p]];
+    z[i] = sum;
+  }
+  for (size_t i = n; i--; ) {
+    T sum = z[i];
+    for (size_t p = this->diagonal_[i] + 1; p != this->rowBegin_[i + 1]; ++p)
+      sum -= this->values_[p] * z[this->colIndex_[p]];
+    z[i] = sum / this->values_[this->diagonal_[i]];
+  }
+}
+
+// Preconditioned conjugate gradient, for symmetric positive definite A
+// (and preconditioner).
+template <typename T, typename Operator, typename Preconditioner>
+IterativeStats
+conjugateGradient(const Operator &a, const std::vector<T> &b,
+                  std::vector<T> &x, const Preconditioner &m,
+                  double tolerance = 1e-10, size_t maxIterations = 1000) {
+  const size_t n = b.size();
+  IterativeStats stats = { 0, 0, false };
+  std::vector<T> r(n), z(n), p(n), q(n);
+  x.resize(n);
+  applyOperator_(a, x, r);
+  for (size_t i = 0; i != n; ++i) r[i] = b[i] - r[i];
+  const double norm = std::sqrt(double(dot_(b, b)));
+  const double bound = tolerance * (norm ? norm : 1);
+  m(r, z);
+  p = z;
+  T rz = dot_(r, z);
+  for (;;) {
+    const double residual = std::sqrt(double(dot_(r, r)));
+    stats.residual = norm ? residual / norm : residual;
+    if ((stats.converged = residual <= bound)) break;
+    if (stats.iterations == maxIterations) break;
+    ++stats.iterations;
+    applyOperator_(a, p, q);
+    const T pq = dot_(p, q);
+    if (pq == T(0)) break;
+    const T alpha = rz / pq;
+    for (size_t i = 0; i != n; ++i) x[i] += alpha * p[i], r[i] -= alpha * q[i];
+    m(r, z);
+    const T next = dot_(r, z), beta = next / rz;
+    rz = next;
+    for (size_t i = 0; i != n; ++i) p[i] = z[i] + beta * p[i];
+  }
+  return stats;
+}
+
+template <typename T, typename Operator> IterativeStats
+conjugateGradient(const Operator &a, const std::vector<T> &b,
+                  std::vector<T> &x) {
+  return conjugateGradient(a, b, x, IdentityPreconditioner<T>());
+}
+
+// Right-preconditioned BiCGSTAB, for any nonsingular A. It stops early,
+// not converged, on a breakdown (rho or omega vanishing).
+template <typename T, typename Operator, typename Preconditioner>
+IterativeStats
+biconjugateGradientStabilized(const Operator &a, const std::vector<T> &b,
+                              std::vector<T> &x, const Preconditioner &m,
+                              double tolerance = 1e-10,
+                              size_t maxIterations = 1000) {
+  const size_t n = b.size();
+  IterativeStats stats = { 0, 0, false };
+  std::vector<T> r(n), shadow, p(n, T(0)), v(n, T(0)), s(n), t(n);
+  std::vector<T> pHat(n), sHat(n);
+  x.resize(n);
+  applyOperator_(a, x, r);
+  for (size_t i = 0; i != n; ++i) r[i] = b[i] - r[i];
+  shadow = r;
+  const double norm = std::sqrt(double(dot_(b, b)));
+  const double bound = tolerance * (norm ? norm : 1);
+  T rho = T(1), alpha = T(1), omega = T(1);
+  for (;;) {
+    const double residual = std::sqrt(double(dot_(r, r)));
+    stats.residual = norm ? residual / norm : residual;
+    if ((stats.converged = residual <= bound)) break;
+    if (stats.iterations == maxIterations) break;
+    ++stats.iterations;
+    const T next = dot_(shadow, r);
+    if (next == T(0) || omega == T(0)) break;
+    const T beta = next / rho * (alpha / omega);
+    rho = next;
+    for (size_t i = 0; i != n; ++i) p[i] = r[i] + beta * (p[i] - omega * v[i]);
+    m(p, pHat);
+    applyOperator_(a, pHat, v);
+    const T sv = dot_(shadow, v);
+    if (sv == T(0)) break;
+    alpha = rho / sv;
+    for (size_t i = 0; i != n; ++i) s[i] = r[i] - alpha * v[i];
+    if (std::sqrt(double(dot_(s, s))) <= bound) {
+      for (size_t i = 0; i != n; ++i) x[i] += alpha * pHat[i];
+      r.swap(s);
+      continue;
+    }
+    m(s, sHat);
+    applyOperator_(a, sHat, t);
+    const T tt = dot_(t, t);
+    omega = tt == T(0) ? T(0) : dot_(t, s) / tt;
+    for (size_t i = 0; i != n; ++i) {
+      x[i] += alpha * pHat[i] + omega * sHat[i];
+      r[i] = s[i] - omega * t[i];
+    }
+  }
+  return stats;
+}
+
+template <typename T, typename Operator> IterativeStats
+biconjugateGradientStabilized(const Operator &a, const std::vector<T> &b,
+                              std::vector<T> &x) {
+  return biconjugateGradientStabilized(a, b, x, IdentityPreconditioner<T>());
+}
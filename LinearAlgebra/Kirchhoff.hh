@@ -0,0 +1,246 @@
+#pragma once
+
+#include <algorithm>
+#include <stdexcept>
+#include <vector>
+
+#include "MatrixDecl.hh"
+#include "SparseMatrix.hh"
+#include "VariableMatrix.hh"
+
+// Laplacians of graphs given as edge lists, and what they are for:
+// counting spanning trees (Kirchhoff's matrix-tree theorem) and the
+// expected hitting times of random walks. The matrices are written
+// straight from the edges into the Matrix<T> or SparseMatrix<T> to fill,
+// and the counts and times eliminate in those. Meant for exact T, e.g.
+// Residue or Rational; the edges have any weights convertible to T:
+//   std::vector<GraphEdge<int> > edges;
+//   Residue<int, 998244353> trees =
+//       spanningTrees<Residue<int, 998244353> >(n, edges.begin(), edges.end());
+
+// An edge from -> to, which are vertices in [0, n). Weight 1 counts.
+template <typename T>
+struct GraphEdge {
+  size_t from, to;
+  T weight;
+};
+
+template <typename T>
+GraphEdge<T> makeGraphEdge(size_t from, size_t to, const T &weight = T(1)) {
+  GraphEdge<T> edge = { from, to, weight };
+  return edge;
+}
+
+// L = D - A, where A[from][to] is the sum of the weights of the edges, and
+// D is diagonal with the degrees as follows. Self loops are left out.
+// UndirectedLaplacian: every edge goes both ways, D has the degrees, and
+// L without a row and its column counts the spanning trees.
+// InDegreeLaplacian: D has the in-degrees, and L without row and column
+// root counts the spanning arborescences out of root.
+// OutDegreeLaplacian: D has the out-degrees, and L without row and column
+// root counts the spanning arborescences into root.
+enum LaplacianKind {
+  UndirectedLaplacian, InDegreeLaplacian, OutDegreeLaplacian
+};
+
+// matrix[r][c] += w.
+template <typename T>
+struct LaplacianDense_ {
+  Matrix<T> &matrix;
+
+  explicit LaplacianDense_(Matrix<T> &matrix) : matrix(matrix) {}
+  void operator()(size_t r, size_t c, const T &w) { matrix[r][c] += w; }
+};
+
+// The same as a triplet, added up by the SparseMatrix constructor, at
+// (c, r) instead if transpose.
+template <typename T>
+struct LaplacianSparse_ {
+  std::vector<SparseTriplet<T> > &triplets;
+  bool transpose;
+
+  explicit LaplacianSparse_(std::vector<SparseTriplet<T> > &triplets,
+                            bool transpose = false)
+      : triplets(triplets), transpose(transpose) {}
+  void operator()(size_t r, size_t c, const T &w) {
+    this->triplets.push_back(this->transpose ? makeSparseTriplet(c, r, w)
+                                             : makeSparseTriplet(r, c, w));
+  }
+};
+
+// Calls add(r, c, w) for every term of L, without vertex skip (none if it
+// is n): the vertices after it move up by one. If degree is not NULL,
+// degree[v] is added the weight of every edge the walk may leave v by,
+// self loops included. Throws std::invalid_argument if an edge is out of
+// range.
+template <typename T, typename InputIter, typename Add> void
+laplacianTerms_(size_t n, InputIter begin, InputIter end, LaplacianKind kind,
+                size_t skip, Add &add, T *degree) {
+  for (InputIter it = begin; it != end; ++it) {
+    const size_t u = it->from, v = it->to;
+    if (u >= n || v >= n) throw std::invalid_argument("laplacian");
+    const T w = T(it->weight), minus = T(0) - w;
+    if (degree) {
+      degree[kind == InDegreeLaplacian ? v : u] += w;
+      if (kind == UndirectedLaplacian && u != v) degree[v] += w;
+    }
+    if (u == v) continue;
+    const size_t i = u - (u > skip), j = v - (v > skip);
+    const bool hasU = u != skip, hasV = v != skip;
+    if (kind != InDegreeLaplacian && hasU) add(i, i, w);
+    if (kind != OutDegreeLaplacian && hasV) add(j, j, w);
+    if (hasU && hasV) {
+      add(i, j, minus);
+      if (kind == UndirectedLaplacian) add(j, i, minus);
+    }
+  }
+}
+
+template <typename T> void
+laplacianClear_(Matrix<T> &matrix, size_t len) {
+  if (matrix.row() != len || matrix.col() != len)
+    throw std::invalid_argument("laplacian");
+  for (size_t r = 0; r != len; ++r)
+    std::fill(matrix[r], matrix[r] + len, T(0));
+}
+
+// The Laplacian of the graph of n vertices into matrix, which must be
+// n x n. Throws std::invalid_argument if not, or if an edge is out of
+// range.
+template <typename T, typename InputIter> void
+laplacian(Matrix<T> &matrix, size_t n, InputIter begin, InputIter end,
+          LaplacianKind kind = UndirectedLaplacian) {
+  laplacianClear_(matrix, n);
+  LaplacianDense_<T> add(matrix);
+  laplacianTerms_<T>(n, begin, end, kind, n, add, NULL);
+}
+
+template <typename T, typename InputIter> void
+laplacian(SparseMatrix<T> &matrix, size_t n, InputIter begin, InputIter end,
+          LaplacianKind kind = UndirectedLaplacian) {
+  std::vector<SparseTriplet<T> > triplets;
+  LaplacianSparse_<T> add(triplets);
+  laplacianTerms_<T>(n, begin, end, kind, n, add, NULL);
+  matrix = SparseMatrix<T>(n, n, triplets.begin(), triplets.end());
+}
+
+// The Laplacian without row and column root, the minor of the matrix-tree
+// theorem, into matrix, which must be (n - 1) x (n - 1).
+// Throws std::invalid_argument if not, if root is not a vertex, or if an
+// edge is out of range.
+template <typename T, typename InputIter> void
+reducedLaplacian(Matrix<T> &matrix, size_t n, size_t root,
+                 InputIter begin, InputIter end,
+                 LaplacianKind kind = UndirectedLaplacian) {
+  if (root >= n) throw std::invalid_argument("reducedLaplacian");
+  laplacianClear_(matrix, n - 1);
+  LaplacianDense_<T> add(matrix);
+  laplacianTerms_<T>(n, begin, end, kind, root, add, NULL);
+}
+
+template <typename T, typename InputIter> void
+reducedLaplacian(SparseMatrix<T> &matrix, size_t n, size_t root,
+                 InputIter begin, InputIter end,
+                 LaplacianKind kind = UndirectedLaplacian) {
+  if (root >= n) throw std::invalid_argument("reducedLaplacian");
+  std::vector<SparseTriplet<T> > triplets;
+  LaplacianSparse_<T> add(triplets);
+  laplacianTerms_<T>(n, begin, end, kind, root, add, NULL);
+  matrix = SparseMatrix<T>(n - 1, n - 1, triplets.begin(), triplets.end());
+}
+
+// Whether the structured elimination of SparseMatrix beats the dense one
+// for this many terms of a len x len Laplacian. Graphs with a few edges a
+// vertex fill in little, the dense one wins from some 1/16 nonzeros on.
+inline bool
+laplacianSparse_(size_t terms, size_t len) {
+  return terms * 16 < len * len;
+}
+
+// The determinant of matrix, triangularized in place.
+template <typename T> T
+laplacianDeterminant_(Matrix<T> &matrix) {
+  const size_t len = matrix.row();
+  std::vector<T *> rows(len + 1);
+  for (size_t r = 0; r != len; ++r) rows[r] = matrix[r];
+  T result = triangularize_(&rows[0], len, len) ? T(1) : T(0) - T(1);
+  for (size_t i = 0; i != len && !isZero(result); ++i) result *= rows[i][i];
+  return result;
+}
+
+// The number of spanning trees (arborescences for the directed kinds, see
+// LaplacianKind) of the graph of n vertices, or with weights, the sum of
+// the products of their weights. root is ignored for UndirectedLaplacian.
+// The terms are collected once, then eliminated in a SparseMatrix if few,
+// else in place in a Matrix<T>.
+// Throws std::invalid_argument if root is not a vertex, or if an edge is
+// out of range.
+template <typename T, typename InputIter> T
+spanningTrees(size_t n, InputIter begin, InputIter end,
+              LaplacianKind kind = UndirectedLaplacian, size_t root = 0) {
+  if (!n) return T(1);
+  if (root >= n) throw std::invalid_argument("spanningTrees");
+  const size_t len = n - 1;
+  std::vector<SparseTriplet<T> > triplets;
+  LaplacianSparse_<T> add(triplets);
+  laplacianTerms_<T>(n, begin, end, kind, root, add, NULL);
+  if (laplacianSparse_(triplets.size(), len))
+    return SparseMatrix<T>(len, len,
+                           triplets.begin(), triplets.end()).determinant();
+  Matrix<T> matrix(len, len);
+  laplacianClear_(matrix, len);
+  for (size_t i = 0; i != triplets.size(); ++i)
+    matrix[triplets[i].row][triplets[i].col] += triplets[i].value;
+  return laplacianDeterminant_(matrix);
+}
+
+// The expected number of steps for a random walk from every vertex to
+// reach target, into times (0 at target). The walk leaves v by an edge
+// with the probability of its weight over the degree of v (self loops
+// included): along the edges for OutDegreeLaplacian, against them for
+// InDegreeLaplacian, and either way for UndirectedLaplacian. That is
+// L' t = d, with L' the Laplacian without target (transposed for
+// InDegreeLaplacian) and d the degrees.
+// Returns false, leaving times alone, if target is not reached almost
+// surely from some vertex, or over Residue, if the system happens to be
+// singular modulo the prime.
+// Throws std::invalid_argument if target is not a vertex, or if an edge
+// is out of range.
+template <typename T, typename InputIter> bool
+hittingTimes(size_t n, InputIter begin, InputIter end, size_t target,
+             std::vector<T> &times, LaplacianKind kind = UndirectedLaplacian) {
+  if (target >= n) throw std::invalid_argument("hittingTimes");
+  const size_t len = n - 1;
+  std::vector<T> degree(n + 1, T(0)), x(len + 1);
+  std::vector<SparseTriplet<T> > triplets;
+  LaplacianSparse_<T> add(triplets, kind == InDegreeLaplacian);
+  laplacianTerms_<T>(n, begin, end, kind, target, add, &degree[0]);
+  // A vertex with no way out never gets anywhere.
+  for (size_t v = 0; v != n; ++v)
+    if (v != target && isZero(degree[v])) return false;
+  degree.erase(degree.begin() + target);
+  if (laplacianSparse_(triplets.size(), len)) {
+    const SparseMatrix<T> matrix(len, len, triplets.begin(), triplets.end());
+    if (!matrix.solve(&degree[0], &x[0])) return false;
+  } else {
+    // [L' | d], reduced in place.
+    Matrix<T> matrix(len, len + 1);
+    std::vector<T *> rows(len + 1);
+    std::vector<size_t> pivots(len + 2);
+    for (size_t r = 0; r != len; ++r) {
+      rows[r] = matrix[r];
+      std::fill(rows[r], rows[r] + len, T(0));
+      rows[r][len] = degree[r];
+    }
+    for (size_t i = 0; i != triplets.size(); ++i)
+      rows[triplets[i].row][triplets[i].col] += triplets[i].value;
+    if (echelon_(&rows[0], len, len + 1, &pivots[0], true) != len
+        || (len && pivots[len - 1] != len - 1))
+      return false;
+    for (size_t r = 0; r != len; ++r) x[r] = rows[r][len];
+  }
+  times.assign(n, T(0));
+  for (size_t v = 0, i = 0; v != n; ++v)
+    if (v != target) times[v] = x[i++];
+  return true;
+}
@@ -2,16 +2,22 @@
 
 #include <algorithm>
 #include <stdexcept>
+#include <vector>
 
 #include "MatrixDecl.hh"
+#include "MatrixExpression.hh"
+#include "MatrixView.hh"
+#include "Transpose.hh"
 
-template <typename T, size_t Row, size_t Col> Matrix<T, Row, Col> &
+template <typename T, size_t Row, size_t Col>
+MATRIX_CONSTEXPR Matrix<T, Row, Col> &
 operator+=(Matrix<T, Row, Col> &, const Matrix<T, Row, Col> &);
-template <typename T, size_t Row, size_t Col> Matrix<T, Row, Col> &
+template <typename T, size_t Row, size_t Col>
+MATRIX_CONSTEXPR Matrix<T, Row, Col> &
 operator-=(Matrix<T, Row, Col> &, const Matrix<T, Row, Col> &);
-template <typename T, size_t Row, size_t Col> bool
+template <typename T, size_t Row, size_t Col> MATRIX_CONSTEXPR bool
 operator==(const Matrix<T, Row, Col> &, const Matrix<T, Row, Col> &);
-template <typename T, size_t Row, size_t Col> bool
+template <typename T, size_t Row, size_t Col> MATRIX_CONSTEXPR bool
 operator!=(const Matrix<T, Row, Col> &, const Matrix<T, Row, Col> &);
 
 // Matrix<T, Row, Col> is fixed-sized at runtime.
@@ -21,25 +27,54 @@ operator!=(const Matrix<T, Row, Col> &, const Matrix<T, Row, Col> &);
 template <typename T, size_t Row, size_t Col>
 class Matrix {
  public:
-  Matrix();
-  Matrix(const Matrix &);
+  MATRIX_CONSTEXPR Matrix();
+  MATRIX_CONSTEXPR Matrix(const Matrix &);
 #if __cplusplus >= 201103L
   template <typename Head, typename ...Tail>
-  Matrix(const Head (&)[Col], const Tail (&...tail)[Col]);
+  MATRIX_CONSTEXPR Matrix(const Head (&)[Col], const Tail (&...tail)[Col]);
+  // Evaluates A + B * C and the like in place, see MatrixExpression.hh.
+  template <typename Expr, typename = typename Expr::IsMatrixExpression>
+  MATRIX_CONSTEXPR Matrix(const Expr &);
+  template <typename Expr, typename = typename Expr::IsMatrixExpression>
+  Matrix &operator=(const Expr &);
 #endif  // __cplusplus >= 201103L
 
-  Matrix &operator=(const Matrix &);
-  T *operator[](size_t row);
-  const T *operator[](size_t row) const;
+  MATRIX_CONSTEXPR Matrix &operator=(const Matrix &);
+  MATRIX_CONSTEXPR T *operator[](size_t row);
+  MATRIX_CONSTEXPR const T *operator[](size_t row) const;
 
-  size_t col() const;
-  size_t row() const;
+  MATRIX_CONSTEXPR size_t col() const;
+  MATRIX_CONSTEXPR size_t row() const;
 
-  Matrix &copyFrom(const Matrix &);
-  Matrix &copyFromArray(const T (&arr)[Row][Col]);
+  MATRIX_CONSTEXPR Matrix &copyFrom(const Matrix &);
+  MATRIX_CONSTEXPR Matrix &copyFromArray(const T (&arr)[Row][Col]);
 
   Matrix &triangularize();
   Matrix &eliminate();
+  // With a pivoting policy of MatrixDecl.hh instead of DefaultPivot_,
+  // those which swap columns do not compile.
+  template <typename Pivot> Matrix &triangularize(Pivot);
+  template <typename Pivot> Matrix &eliminate(Pivot);
+  // From a single elimination with EchelonPivot_, see echelon_. solve
+  // returns false if there is no solution, leastSquares is for float and
+  // double, see leastSquaresOf_.
+  size_t rank() const;
+  std::vector<size_t> pivotColumns() const;
+  std::vector<std::vector<T> > nullspace() const;
+  bool solve(const std::vector<T> &, std::vector<T> &) const;
+  std::vector<T> leastSquares(const std::vector<T> &) const;
+
+  // Views on the elements without copying, see MatrixView.hh.
+  MatrixView<T> view();
+  MatrixView<const T> view() const;
+  MatrixView<T> block(size_t, size_t, size_t, size_t);
+  MatrixView<const T> block(size_t, size_t, size_t, size_t) const;
+  MatrixView<T> row(size_t);
+  MatrixView<const T> row(size_t) const;
+  MatrixView<T> col(size_t);
+  MatrixView<const T> col(size_t) const;
+  MatrixView<T> transposed();
+  MatrixView<const T> transposed() const;
 
   friend Matrix &operator+=<>(Matrix &, const Matrix &);
   friend Matrix &operator-=<>(Matrix &, const Matrix &);
@@ -50,268 +85,520 @@ class Matrix {
   T value[Row][Col];
 };
 
-template <typename T, size_t Row, size_t Col>
-Matrix<T, Row, Col>::Matrix() {
-  std::fill(*this->value, *this->value + Row * Col, 0);
-}
+// value() zeroes the elements, and a constexpr constructor has to
+// initialize them all anyway.
+template <typename T, size_t Row, size_t Col> MATRIX_CONSTEXPR
+Matrix<T, Row, Col>::Matrix() : value() {}
 
-template <typename T, size_t Row, size_t Col>
-Matrix<T, Row, Col>::Matrix(const Matrix &that) {
+template <typename T, size_t Row, size_t Col> MATRIX_CONSTEXPR
+Matrix<T, Row, Col>::Matrix(const Matrix &that) : value() {
   this->copyFrom(that);
 }
 
 #if __cplusplus >= 201103L
 template <typename T, size_t Row, size_t Col>
-template <typename Head, typename ...Tail>
+template <typename Head, typename ...Tail> MATRIX_CONSTEXPR
 Matrix<T, Row, Col>::Matrix(const Head (&head)[Col],
-                            const Tail (&...tail)[Col]) {
+                            const Tail (&...tail)[Col]) : value() {
   static_assert(sizeof...(tail) == Row - 1, "Size not match");
   const Head *array[Row] = { head, tail... };
-  // Well, std::begin and std::end are redundancy for arrays.
+  // Plain loops, std::copy is not constexpr until C++20.
   for (size_t r = 0; r != Row; ++r)
-    std::copy(array[r], array[r] + Col, this->value[r]);
+    for (size_t c = 0; c != Col; ++c) this->value[r][c] = array[r][c];
+}
+
+template <typename T, size_t Row, size_t Col> template <typename Expr, typename>
+MATRIX_CONSTEXPR Matrix<T, Row, Col>::Matrix(const Expr &expr) : value() {
+  static_assert(std::is_same<typename Expr::Result, Matrix>::value,
+                "Type not match");
+  expr.template assignTo<false>(*this);
+}
+
+template <typename T, size_t Row, size_t Col> template <typename Expr, typename>
+Matrix<T, Row, Col> &Matrix<T, Row, Col>::operator=(const Expr &expr) {
+  static_assert(std::is_same<typename Expr::Result, Matrix>::value,
+                "Type not match");
+  if (expr.clobbers(spanOf_(*this))) return this->copyFrom(Matrix(expr));
+  expr.template assignTo<false>(*this);
+  return *this;
 }
 #endif  // __cplusplus >= 201103L
 
-template <typename T, size_t Row, size_t Col> Matrix<T, Row, Col> &
+template <typename T, size_t Row, size_t Col>
+MATRIX_CONSTEXPR Matrix<T, Row, Col> &
 Matrix<T, Row, Col>::operator=(const Matrix<T, Row, Col> &that) {
   return this->copyFrom(that);
 }
 
-template <typename T, size_t Row, size_t Col> Matrix<T, Row, Col> &
+template <typename T, size_t Row, size_t Col>
+MATRIX_CONSTEXPR Matrix<T, Row, Col> &
 Matrix<T, Row, Col>::copyFrom(const Matrix<T, Row, Col> &that) {
   return this->copyFromArray(that.value);
 }
 
-template <typename T, size_t Row, size_t Col> Matrix<T, Row, Col> &
+template <typename T, size_t Row, size_t Col>
+MATRIX_CONSTEXPR Matrix<T, Row, Col> &
 Matrix<T, Row, Col>::copyFromArray(const T (&array)[Row][Col]) {
-  std::copy(*array, *array + Row * Col, *this->value);
+  for (size_t r = 0; r != Row; ++r)
+    for (size_t c = 0; c != Col; ++c) this->value[r][c] = array[r][c];
   return *this;
 }
 
-template <typename T, size_t Row, size_t Col> T *
+template <typename T, size_t Row, size_t Col> MATRIX_CONSTEXPR T *
 Matrix<T, Row, Col>::operator[](size_t row) {
   return this->value[row];
 }
 
-template <typename T, size_t Row, size_t Col> const T *
+template <typename T, size_t Row, size_t Col> MATRIX_CONSTEXPR const T *
 Matrix<T, Row, Col>::operator[](size_t row) const {
   return this->value[row];
 }
 
-template <typename T, size_t Row, size_t Col> size_t
+template <typename T, size_t Row, size_t Col> MATRIX_CONSTEXPR size_t
 Matrix<T, Row, Col>::row() const {
   return Row;
 }
 
-template <typename T, size_t Row, size_t Col> size_t
+template <typename T, size_t Row, size_t Col> MATRIX_CONSTEXPR size_t
 Matrix<T, Row, Col>::col() const {
   return Col;
 }
 
 template <typename T, size_t Row, size_t Col> Matrix<T, Row, Col> &
 Matrix<T, Row, Col>::triangularize() {
-  T tria[Row][Col], *matrix[Row];
-  ifCpp11MoveElseCopy(*this->value, *this->value + Row * Col, *tria);
-  std::copy(tria, tria + Row, matrix);
-  triangularize_(matrix, Row, Col);
-  for (size_t r = 0; r != Row; ++r)
-    ifCpp11MoveElseCopy(matrix[r], matrix[r] + Col, this->value[r]);
-  return *this;
+  return this->triangularize(typename DefaultPivot_<T>::type());
 }
 
 template <typename T, size_t Row, size_t Col> Matrix<T, Row, Col> &
 Matrix<T, Row, Col>::eliminate() {
-  T elim[Row][Col], *matrix[Row];
-  ifCpp11MoveElseCopy(*this->value, *this->value + Row * Col, *elim);
-  std::copy(elim, elim + Row, matrix);
-  triangularize_(matrix, Row, Col);
+  return this->eliminate(typename DefaultPivot_<T>::type());
+}
+
+// Eliminates in place, the pivoting only permutes the row pointers,
+// which are put back by permuteRows_ at last.
+template <typename T, size_t Row, size_t Col> template <typename Pivot>
+Matrix<T, Row, Col> &Matrix<T, Row, Col>::triangularize(Pivot pivot) {
+  (void)sizeof(PivotKeepsColumns_<!Pivot::swapsColumns>);
+  T *matrix[Row];
+  for (size_t r = 0; r != Row; ++r) matrix[r] = this->value[r];
+  triangularize_(matrix, Row, Col, pivot, NULL);
+  permuteRows_(matrix, *this->value, Row, Col, Col);
+  return *this;
+}
+
+template <typename T, size_t Row, size_t Col> template <typename Pivot>
+Matrix<T, Row, Col> &Matrix<T, Row, Col>::eliminate(Pivot pivot) {
+  (void)sizeof(PivotKeepsColumns_<!Pivot::swapsColumns>);
+  T *matrix[Row];
+  for (size_t r = 0; r != Row; ++r) matrix[r] = this->value[r];
+  triangularize_(matrix, Row, Col, pivot, NULL);
   canonicalize_(matrix, Row, Col);
-  for (size_t r = 0; r != Row; ++r)
-    ifCpp11MoveElseCopy(matrix[r], matrix[r] + Col, this->value[r]);
+  permuteRows_(matrix, *this->value, Row, Col, Col);
   return *this;
 }
 
+template <typename T, size_t Row, size_t Col> size_t
+Matrix<T, Row, Col>::rank() const {
+  return rankOf_<T>(*this);
+}
+
+template <typename T, size_t Row, size_t Col> std::vector<size_t>
+Matrix<T, Row, Col>::pivotColumns() const {
+  return pivotColumnsOf_<T>(*this);
+}
+
+template <typename T, size_t Row, size_t Col> std::vector<std::vector<T> >
+Matrix<T, Row, Col>::nullspace() const {
+  return nullspaceOf_<T>(*this);
+}
+
+template <typename T, size_t Row, size_t Col> bool
+Matrix<T, Row, Col>::solve(const std::vector<T> &b, std::vector<T> &x) const {
+  return solveOf_(*this, b, x);
+}
+
+template <typename T, size_t Row, size_t Col> std::vector<T>
+Matrix<T, Row, Col>::leastSquares(const std::vector<T> &b) const {
+  return leastSquaresOf_(*this, b);
+}
+
+template <typename T, size_t Row, size_t Col> MatrixView<T>
+Matrix<T, Row, Col>::view() {
+  return MatrixView<T>(*this->value, Row, Col, Col, 1);
+}
+
+template <typename T, size_t Row, size_t Col> MatrixView<const T>
+Matrix<T, Row, Col>::view() const {
+  return MatrixView<const T>(*this->value, Row, Col, Col, 1);
+}
+
+template <typename T, size_t Row, size_t Col> MatrixView<T>
+Matrix<T, Row, Col>::block(size_t r, size_t c, size_t h, size_t w) {
+  return this->view().block(r, c, h, w);
+}
+
+template <typename T, size_t Row, size_t Col> MatrixView<const T>
+Matrix<T, Row, Col>::block(size_t r, size_t c, size_t h, size_t w) const {
+  return this->view().block(r, c, h, w);
+}
+
+template <typename T, size_t Row, size_t Col> MatrixView<T>
+Matrix<T, Row, Col>::row(size_t r) {
+  return this->view().row(r);
+}
+
+template <typename T, size_t Row, size_t Col> MatrixView<const T>
+Matrix<T, Row, Col>::row(size_t r) const {
+  return this->view().row(r);
+}
+
+template <typename T, size_t Row, size_t Col> MatrixView<T>
+Matrix<T, Row, Col>::col(size_t c) {
+  return this->view().col(c);
+}
+
+template <typename T, size_t Row, size_t Col> MatrixView<const T>
+Matrix<T, Row, Col>::col(size_t c) const {
+  return this->view().col(c);
+}
+
+template <typename T, size_t Row, size_t Col> MatrixView<T>
+Matrix<T, Row, Col>::transposed() {
+  return this->view().transposed();
+}
+
+template <typename T, size_t Row, size_t Col> MatrixView<const T>
+Matrix<T, Row, Col>::transposed() const {
+  return this->view().transposed();
+}
+
 // Matrix<T, Len, Len> is square matrix,
 // which is a special case of fix-sized matrix.
 template <typename T, size_t Len>
 class Matrix<T, Len, Len> {
  public:
-  Matrix();
-  Matrix(const T &);
-  Matrix(const Matrix &);
+  MATRIX_CONSTEXPR Matrix();
+  // init on the diagonal, zeros elsewhere.
+  MATRIX_CONSTEXPR Matrix(const T &);
+  MATRIX_CONSTEXPR Matrix(const Matrix &);
 #if __cplusplus >= 201103L
   template <typename Head, typename ...Tail>
-  Matrix(const Head (&)[Len], const Tail (&...tail)[Len]);
+  MATRIX_CONSTEXPR Matrix(const Head (&)[Len], const Tail (&...tail)[Len]);
+  template <typename Expr, typename = typename Expr::IsMatrixExpression>
+  MATRIX_CONSTEXPR Matrix(const Expr &);
+  template <typename Expr, typename = typename Expr::IsMatrixExpression>
+  Matrix &operator=(const Expr &);
 #endif
 
-  Matrix &operator=(const Matrix &);
-  T *operator[](size_t row);
-  const T *operator[](size_t row) const;
+  MATRIX_CONSTEXPR Matrix &operator=(const Matrix &);
+  MATRIX_CONSTEXPR T *operator[](size_t row);
+  MATRIX_CONSTEXPR const T *operator[](size_t row) const;
 
-  size_t row() const;
-  size_t col() const;
-  Matrix &copyFrom(const Matrix &);
-  Matrix &copyFromArray(const T (&)[Len][Len]);
+  MATRIX_CONSTEXPR size_t row() const;
+  MATRIX_CONSTEXPR size_t col() const;
+  MATRIX_CONSTEXPR Matrix &copyFrom(const Matrix &);
+  MATRIX_CONSTEXPR Matrix &copyFromArray(const T (&)[Len][Len]);
 
   Matrix &transpose();
   Matrix &triangularize();
   Matrix &eliminate();
   Matrix &inverse();
   T determinant() const;
+  // With a pivoting policy of MatrixDecl.hh instead of DefaultPivot_.
+  // Those which swap columns (CompletePivot, RookPivot) only make sense
+  // for determinant, the others do not compile with them.
+  template <typename Pivot> Matrix &triangularize(Pivot);
+  template <typename Pivot> Matrix &eliminate(Pivot);
+  template <typename Pivot> T determinant(Pivot) const;
+  // det(xI - A), from the constant term up.
+  std::vector<T> characteristicPolynomial() const;
+  // From a single elimination with EchelonPivot_, see echelon_. solve
+  // returns false if there is no solution, leastSquares is for float and
+  // double, see leastSquaresOf_.
+  size_t rank() const;
+  std::vector<size_t> pivotColumns() const;
+  std::vector<std::vector<T> > nullspace() const;
+  bool solve(const std::vector<T> &, std::vector<T> &) const;
+  std::vector<T> leastSquares(const std::vector<T> &) const;
+
+  // Views on the elements without copying, see MatrixView.hh.
+  MatrixView<T> view();
+  MatrixView<const T> view() const;
+  MatrixView<T> block(size_t, size_t, size_t, size_t);
+  MatrixView<const T> block(size_t, size_t, size_t, size_t) const;
+  MatrixView<T> row(size_t);
+  MatrixView<const T> row(size_t) const;
+  MatrixView<T> col(size_t);
+  MatrixView<const T> col(size_t) const;
+  MatrixView<T> transposed();
+  MatrixView<const T> transposed() const;
 
   friend Matrix &operator+=<>(Matrix &, const Matrix &);
   friend Matrix &operator-=<>(Matrix &, const Matrix &);
+  friend bool operator==<>(const Matrix &, const Matrix &);
+  friend bool operator!=<>(const Matrix &, const Matrix &);
 
  private:
   T value[Len][Len];
 };
 
-template <typename T, size_t Len>
-Matrix<T, Len, Len>::Matrix() {
-  std::fill(*this->value, *this->value + Len, 0);
-}
+template <typename T, size_t Len> MATRIX_CONSTEXPR
+Matrix<T, Len, Len>::Matrix() : value() {}
 
-template <typename T, size_t Len>
-Matrix<T, Len, Len>::Matrix(const T &init) {
+template <typename T, size_t Len> MATRIX_CONSTEXPR
+Matrix<T, Len, Len>::Matrix(const T &init) : value() {
   for (size_t i = 0; i != Len; ++i) this->value[i][i] = init;
 }
 
-template <typename T, size_t Len>
-Matrix<T, Len, Len>::Matrix(const Matrix &that) {
+template <typename T, size_t Len> MATRIX_CONSTEXPR
+Matrix<T, Len, Len>::Matrix(const Matrix &that) : value() {
   this->copyFrom(that);
 }
 
 #if __cplusplus >= 201103L
 template <typename T, size_t Len> template <typename Head, typename ...Tail>
-Matrix<T, Len, Len>::Matrix(const Head (&head)[Len],
-                            const Tail (&...tail)[Len]) {
+MATRIX_CONSTEXPR Matrix<T, Len, Len>::Matrix(const Head (&head)[Len],
+                                             const Tail (&...tail)[Len])
+    : value() {
   static_assert(sizeof...(tail) == Len - 1, "Size not match");
   const Head *array[Len] = { head, tail... };
   for (size_t i = 0; i != Len; ++i)
-    std::copy(array[i], array[i] + Len, this->value[i]);
+    for (size_t j = 0; j != Len; ++j) this->value[i][j] = array[i][j];
+}
+
+template <typename T, size_t Len> template <typename Expr, typename>
+MATRIX_CONSTEXPR Matrix<T, Len, Len>::Matrix(const Expr &expr) : value() {
+  static_assert(std::is_same<typename Expr::Result, Matrix>::value,
+                "Type not match");
+  expr.template assignTo<false>(*this);
+}
+
+template <typename T, size_t Len> template <typename Expr, typename>
+Matrix<T, Len, Len> &Matrix<T, Len, Len>::operator=(const Expr &expr) {
+  static_assert(std::is_same<typename Expr::Result, Matrix>::value,
+                "Type not match");
+  if (expr.clobbers(spanOf_(*this))) return this->copyFrom(Matrix(expr));
+  expr.template assignTo<false>(*this);
+  return *this;
 }
 #endif
 
-template <typename T, size_t Len> Matrix<T, Len, Len> &
+template <typename T, size_t Len> MATRIX_CONSTEXPR Matrix<T, Len, Len> &
 Matrix<T, Len, Len>::operator=(const Matrix<T, Len, Len> &that) {
   return this->copyFrom(that);
 }
 
-template <typename T, size_t Len> T *
+template <typename T, size_t Len> MATRIX_CONSTEXPR T *
 Matrix<T, Len, Len>::operator[](size_t row) {
   return this->value[row];
 }
 
-template <typename T, size_t Len> const T *
+template <typename T, size_t Len> MATRIX_CONSTEXPR const T *
 Matrix<T, Len, Len>::operator[](size_t row) const {
   return this->value[row];
 }
 
-template <typename T, size_t Len> size_t
+template <typename T, size_t Len> MATRIX_CONSTEXPR size_t
 Matrix<T, Len, Len>::row() const {
   return Len;
 }
 
-template <typename T, size_t Len> size_t
+template <typename T, size_t Len> MATRIX_CONSTEXPR size_t
 Matrix<T, Len, Len>::col() const {
   return Len;
 }
 
-template <typename T, size_t Len> Matrix<T, Len, Len> &
+template <typename T, size_t Len> MATRIX_CONSTEXPR Matrix<T, Len, Len> &
 Matrix<T, Len, Len>::copyFrom(const Matrix<T, Len, Len> &that) {
   return this->copyFromArray(that.value);
 }
 
-template <typename T, size_t Len> Matrix<T, Len, Len> &
+template <typename T, size_t Len> MATRIX_CONSTEXPR Matrix<T, Len, Len> &
 Matrix<T, Len, Len>::copyFromArray(const T (&array)[Len][Len]) {
-  std::copy(*array, *array + Len * Len, *this->value);
+  for (size_t i = 0; i != Len; ++i)
+    for (size_t j = 0; j != Len; ++j) this->value[i][j] = array[i][j];
   return *this;
 }
 
 template <typename T, size_t Len> Matrix<T, Len, Len> &
 Matrix<T, Len, Len>::transpose() {
-  for (size_t i = 0; i != Len; ++i)
-    for (size_t j = i + 1; j != Len; ++j)
-      std::swap(this->value[i][j], this->value[j][i]);
+  transposeSquare_(*this->value, Len, Len);
   return *this;
 }
 
 template <typename T, size_t Len> Matrix<T, Len, Len> &
 Matrix<T, Len, Len>::triangularize() {
-  T tria[Len][Len], *matrix[Len];
-  ifCpp11MoveElseCopy(*this->value, *this->value + Len * Len, *tria);
-  std::copy(tria, tria + Len, matrix);
-  triangularize_(matrix, Len, Len);
-  for (size_t i = 0; i != Len; ++i)
-    ifCpp11MoveElseCopy(matrix[i], matrix[i] + Len, this->value[i]);
-  return *this;
+  return this->triangularize(typename DefaultPivot_<T>::type());
 }
 
 template <typename T, size_t Len> Matrix<T, Len, Len> &
 Matrix<T, Len, Len>::eliminate() {
-  T elim[Len][Len], *matrix[Len];
-  ifCpp11MoveElseCopy(*this->value, *this->value + Len * Len, *elim);
-  std::copy(elim, elim + Len, matrix);
-  triangularize_(matrix, Len, Len);
-  canonicalize_(matrix, Len, Len);
-  for (size_t i = 0; i != Len; ++i)
-    ifCpp11MoveElseCopy(matrix[i], matrix[i] + Len, this->value[i]);
-  return *this;
+  return this->eliminate(typename DefaultPivot_<T>::type());
 }
 
 template <typename T, size_t Len> T
 Matrix<T, Len, Len>::determinant() const {
+  return this->determinant(typename DefaultPivot_<T>::type());
+}
+
+template <typename T, size_t Len> template <typename Pivot>
+Matrix<T, Len, Len> &Matrix<T, Len, Len>::triangularize(Pivot pivot) {
+  (void)sizeof(PivotKeepsColumns_<!Pivot::swapsColumns>);
+  T *matrix[Len];
+  for (size_t i = 0; i != Len; ++i) matrix[i] = this->value[i];
+  triangularize_(matrix, Len, Len, pivot, NULL);
+  permuteRows_(matrix, *this->value, Len, Len, Len);
+  return *this;
+}
+
+template <typename T, size_t Len> template <typename Pivot>
+Matrix<T, Len, Len> &Matrix<T, Len, Len>::eliminate(Pivot pivot) {
+  (void)sizeof(PivotKeepsColumns_<!Pivot::swapsColumns>);
+  T *matrix[Len];
+  for (size_t i = 0; i != Len; ++i) matrix[i] = this->value[i];
+  triangularize_(matrix, Len, Len, pivot, NULL);
+  canonicalize_(matrix, Len, Len);
+  permuteRows_(matrix, *this->value, Len, Len, Len);
+  return *this;
+}
+
+template <typename T, size_t Len> template <typename Pivot> T
+Matrix<T, Len, Len>::determinant(Pivot pivot) const {
   Matrix temporary = *this;
   T *matrix[Len];
   for (size_t i = 0; i != Len; ++i) matrix[i] = temporary.value[i];
-  T result = triangularize_(matrix, Len, Len) ? 1 : -1;
+  T result = triangularize_(matrix, Len, Len, pivot, NULL) ? 1 : -1;
   for (size_t i = 0; i != Len; ++i)
-    if (isZero(result *= matrix[i][i])) return 0;
+    if ((result *= matrix[i][i]) == T(0)) return 0;
   return result;
 }
 
-// Throws std::invalid_argument if not inversible.
+template <typename T, size_t Len> size_t
+Matrix<T, Len, Len>::rank() const {
+  return rankOf_<T>(*this);
+}
+
+template <typename T, size_t Len> std::vector<size_t>
+Matrix<T, Len, Len>::pivotColumns() const {
+  return pivotColumnsOf_<T>(*this);
+}
+
+template <typename T, size_t Len> std::vector<std::vector<T> >
+Matrix<T, Len, Len>::nullspace() const {
+  return nullspaceOf_<T>(*this);
+}
+
+template <typename T, size_t Len> bool
+Matrix<T, Len, Len>::solve(const std::vector<T> &b, std::vector<T> &x) const {
+  return solveOf_(*this, b, x);
+}
+
+template <typename T, size_t Len> std::vector<T>
+Matrix<T, Len, Len>::leastSquares(const std::vector<T> &b) const {
+  return leastSquaresOf_(*this, b);
+}
+
+// Hessenberg reduction then its recurrence, see characteristicPolynomial_.
+template <typename T, size_t Len> std::vector<T>
+Matrix<T, Len, Len>::characteristicPolynomial() const {
+  Matrix temporary = *this;
+  T *matrix[Len];
+  for (size_t i = 0; i != Len; ++i) matrix[i] = temporary.value[i];
+  std::vector<T> poly((Len + 1) * (Len + 1));
+  const T *const result = characteristicPolynomial_(matrix, Len, &poly[0]);
+  return std::vector<T>(result, result + Len + 1);
+}
+
+// In-place Gauss-Jordan, see inverse_.
+// Throws std::invalid_argument if not inversible, and the matrix is
+// unspecified then.
 template <typename T, size_t Len> Matrix<T, Len, Len> &
 Matrix<T, Len, Len>::inverse() {
-  T concat[Len][Len * 2], *matrix[Len];
-  for (size_t i = 0; i != Len; ++i) {
-    ifCpp11MoveElseCopy(this->value[i], this->value[i] + Len, concat[i]);
-    std::fill(concat[i] + Len, concat[i] + Len * 2, 0);
-    concat[i][Len + i] = 1;
-  }
-  std::copy(concat, concat + Len, matrix);
-  triangularize_(matrix, Len, Len * 2);
-  // Give up if not inversible
-  for (size_t i = 0; i != Len; ++i)
-    if (isZero(matrix[i][Len + i]))
-      throw std::invalid_argument("Matrix::inverse");
-  canonicalize_(matrix, Len, Len * 2);
-  for (size_t i = 0; i != Len; ++i)
-    ifCpp11MoveElseCopy(matrix[i] + Len, matrix[i] + Len * 2, this->value[i]);
+  T *matrix[Len];
+  size_t pivot[Len];
+  for (size_t i = 0; i != Len; ++i) matrix[i] = this->value[i];
+  if (!inverse_(matrix, Len, pivot))
+    throw std::invalid_argument("Matrix::inverse");
+  permuteRows_(matrix, *this->value, Len, Len, Len);
   return *this;
 }
 
-template <typename T, size_t Row, size_t Col> Matrix<T, Row, Col> &
+template <typename T, size_t Row, size_t Col>
+MATRIX_CONSTEXPR Matrix<T, Row, Col> &
 operator+=(Matrix<T, Row, Col> &lhs, const Matrix<T, Row, Col> &rhs) {
-  std::transform(*lhs.value, *lhs.value + Row * Col,
-                 *rhs.value, *lhs.value, std::plus<T>());
+  for (size_t r = 0; r != Row; ++r)
+    for (size_t c = 0; c != Col; ++c) lhs.value[r][c] += rhs.value[r][c];
   return lhs;
 }
 
+template <typename T, size_t Len> MatrixView<T>
+Matrix<T, Len, Len>::view() {
+  return MatrixView<T>(*this->value, Len, Len, Len, 1);
+}
+
+template <typename T, size_t Len> MatrixView<const T>
+Matrix<T, Len, Len>::view() const {
+  return MatrixView<const T>(*this->value, Len, Len, Len, 1);
+}
+
+template <typename T, size_t Len> MatrixView<T>
+Matrix<T, Len, Len>::block(size_t r, size_t c, size_t h, size_t w) {
+  return this->view().block(r, c, h, w);
+}
+
+template <typename T, size_t Len> MatrixView<const T>
+Matrix<T, Len, Len>::block(size_t r, size_t c, size_t h, size_t w) const {
+  return this->view().block(r, c, h, w);
+}
+
+template <typename T, size_t Len> MatrixView<T>
+Matrix<T, Len, Len>::row(size_t r) {
+  return this->view().row(r);
+}
+
+template <typename T, size_t Len> MatrixView<const T>
+Matrix<T, Len, Len>::row(size_t r) const {
+  return this->view().row(r);
+}
+
+template <typename T, size_t Len> MatrixView<T>
+Matrix<T, Len, Len>::col(size_t c) {
+  return this->view().col(c);
+}
+
+template <typename T, size_t Len> MatrixView<const T>
+Matrix<T, Len, Len>::col(size_t c) const {
+  return this->view().col(c);
+}
+
+template <typename T, size_t Len> MatrixView<T>
+Matrix<T, Len, Len>::transposed() {
+  return this->view().transposed();
+}
+
+template <typename T, size_t Len> MatrixView<const T>
+Matrix<T, Len, Len>::transposed() const {
+  return this->view().transposed();
+}
+
+// Since C++11 operator+, - and * are lazy, see MatrixExpression.hh.
+#if __cplusplus < 201103L
 template <typename T, size_t Row, size_t Col> Matrix<T, Row, Col>
 operator+(const Matrix<T, Row, Col> &lhs, const Matrix<T, Row, Col> &rhs) {
   Matrix<T, Row, Col> result = lhs;
   return result += rhs;
 }
+#endif  // __cplusplus < 201103L
 
-template <typename T, size_t Row, size_t Col> Matrix<T, Row, Col> &
+template <typename T, size_t Row, size_t Col>
+MATRIX_CONSTEXPR Matrix<T, Row, Col> &
 operator-=(Matrix<T, Row, Col> &lhs, const Matrix<T, Row, Col> &rhs) {
-  std::transform(*lhs.value, *lhs.value + Row * Col,
-                 *rhs.value, *lhs.value, std::minus<T>());
+  for (size_t r = 0; r != Row; ++r)
+    for (size_t c = 0; c != Col; ++c) lhs.value[r][c] -= rhs.value[r][c];
   return lhs;
 }
 
+#if __cplusplus < 201103L
 template <typename T, size_t Row, size_t Col> Matrix<T, Row, Col>
 operator-(const Matrix<T, Row, Col> &lhs, const Matrix<T, Row, Col> &rhs) {
   Matrix<T, Row, Col> result = lhs;
@@ -329,6 +616,7 @@ operator*(const Matrix<T, Row, Mid> &lhs, const Matrix<T, Mid, Col> &rhs) {
     }
   return result;
 }
+#endif  // __cplusplus < 201103L
 
 template <typename T, size_t Row, size_t Col> Matrix<T, Row, Col>
 operator*=(Matrix<T, Row, Col> &lhs, const Matrix<T, Col, Col> &rhs) {
@@ -336,12 +624,39 @@ operator*=(Matrix<T, Row, Col> &lhs, const Matrix<T, Col, Col> &rhs) {
   return lhs = result * rhs;
 }
 
-template <typename T, size_t Row, size_t Col> bool
+template <typename T, size_t Row, size_t Col> MATRIX_CONSTEXPR bool
 operator==(const Matrix<T, Row, Col> &lhs, const Matrix<T, Row, Col> &rhs) {
-  return std::equal(*lhs.value, *lhs.value + Row * Col, *rhs.value);
+  for (size_t r = 0; r != Row; ++r)
+    for (size_t c = 0; c != Col; ++c)
+      if (!(lhs.value[r][c] == rhs.value[r][c])) return false;
+  return true;
 }
 
-template <typename T, size_t Row, size_t Col> bool
+template <typename T, size_t Row, size_t Col> MATRIX_CONSTEXPR bool
 operator!=(const Matrix<T, Row, Col> &lhs, const Matrix<T, Row, Col> &rhs) {
   return !(lhs == rhs);
 }
+
+// A transposed copy. Unlike the member transpose it is plain loops, so it
+// can run at compile time.
+template <typename T, size_t Row, size_t Col>
+MATRIX_CONSTEXPR Matrix<T, Col, Row>
+transpose(const Matrix<T, Row, Col> &matrix) {
+  Matrix<T, Col, Row> result;
+  for (size_t r = 0; r != Row; ++r)
+    for (size_t c = 0; c != Col; ++c) result[c][r] = matrix[r][c];
+  return result;
+}
+
+// matrix^exponent by squaring, e.g. the transition matrix of a linear
+// recurrence, at compile time since C++14:
+//   constexpr Matrix<long long, 2, 2> f = power(fibonacci, 1 << 20);
+template <typename T, size_t Len> MATRIX_CONSTEXPR Matrix<T, Len, Len>
+power(const Matrix<T, Len, Len> &matrix, unsigned long long exponent) {
+  Matrix<T, Len, Len> result(T(1)), base(matrix);
+  for (; exponent; exponent >>= 1) {
+    if (exponent & 1) result = Matrix<T, Len, Len>(result * base);
+    if (exponent > 1) base = Matrix<T, Len, Len>(base * base);
+  }
+  return result;
+}
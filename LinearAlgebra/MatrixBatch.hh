@@ -0,0 +1,339 @@
+#pragma once
+
+#include <stdexcept>
+#include <vector>
+
+#include "Matrix.hh"
+
+template <typename T, size_t Len> class Vector;
+
+// Many Matrix<T, Row, Col> at once, for hot loops over lots of independent
+// small matrices, e.g. millions of 4 x 4 transforms a frame. A vector is
+// a 1 x Len matrix, so Vector * Matrix is batched as well.
+// The matrices are kept in groups of Lane (array of structure of arrays):
+// element (r, c) of the Lane matrices of a group are adjacent, and every
+// loop below runs over the Lane matrices innermost, which the compiler
+// turns into SIMD code. 8 doubles are one AVX-512 register or two AVX ones.
+// The last group is padded with zero matrices.
+template <typename T, size_t Row, size_t Col, size_t Lane = 8>
+class MatrixBatch {
+ public:
+  MatrixBatch();
+  explicit MatrixBatch(size_t);
+
+  size_t size() const;
+  void resize(size_t);
+  // Element (r, c) of the k-th matrix.
+  T &at(size_t, size_t, size_t);
+  const T &at(size_t, size_t, size_t) const;
+  void load(size_t, Matrix<T, Row, Col> &) const;
+  void store(size_t, const Matrix<T, Row, Col> &);
+  // Only if Row is 1, throws std::invalid_argument otherwise.
+  void load(size_t, Vector<T, Col> &) const;
+  void store(size_t, const Vector<T, Col> &);
+
+  // Group g is Row * Col * Lane elements, element (r, c) of its k-th
+  // matrix is at (r * Col + c) * Lane + k.
+  size_t groups() const;
+  T *group(size_t);
+  const T *group(size_t) const;
+
+  // Only for square matrices, throw std::invalid_argument otherwise.
+  // Unlike Matrix<T, Len, Len>::inverse, a singular matrix does not throw
+  // but becomes zero, as its determinant tells.
+  void determinant(T *) const;
+  MatrixBatch &inverse();
+
+ private:
+  size_t size_;
+  std::vector<T> value;
+
+  static void pivot_(T *, T *, size_t, size_t, bool *, bool *);
+};
+
+template <typename T, size_t Row, size_t Col, size_t Lane>
+MatrixBatch<T, Row, Col, Lane>::MatrixBatch() : size_(0) {
+}
+
+template <typename T, size_t Row, size_t Col, size_t Lane>
+MatrixBatch<T, Row, Col, Lane>::MatrixBatch(size_t size) : size_(0) {
+  this->resize(size);
+}
+
+template <typename T, size_t Row, size_t Col, size_t Lane> size_t
+MatrixBatch<T, Row, Col, Lane>::size() const {
+  return this->size_;
+}
+
+// New matrices are zero.
+template <typename T, size_t Row, size_t Col, size_t Lane> void
+MatrixBatch<T, Row, Col, Lane>::resize(size_t size) {
+  const size_t groups = (size + Lane - 1) / Lane;
+  // Clears the padding of the last group which is now in use.
+  for (size_t k = size; k < this->size_; ++k)
+    for (size_t r = 0; r != Row; ++r)
+      for (size_t c = 0; c != Col; ++c) this->at(k, r, c) = T(0);
+  this->value.resize(groups * Row * Col * Lane, T(0));
+  this->size_ = size;
+}
+
+template <typename T, size_t Row, size_t Col, size_t Lane> T &
+MatrixBatch<T, Row, Col, Lane>::at(size_t k, size_t r, size_t c) {
+  return this->group(k / Lane)[(r * Col + c) * Lane + k % Lane];
+}
+
+template <typename T, size_t Row, size_t Col, size_t Lane> const T &
+MatrixBatch<T, Row, Col, Lane>::at(size_t k, size_t r, size_t c) const {
+  return this->group(k / Lane)[(r * Col + c) * Lane + k % Lane];
+}
+
+template <typename T, size_t Row, size_t Col, size_t Lane> void
+MatrixBatch<T, Row, Col, Lane>::load(size_t k,
+                                     Matrix<T, Row, Col> &matrix) const {
+  for (size_t r = 0; r != Row; ++r)
+    for (size_t c = 0; c != Col; ++c) matrix[r][c] = this->at(k, r, c);
+}
+
+template <typename T, size_t Row, size_t Col, size_t Lane> void
+MatrixBatch<T, Row, Col, Lane>::store(size_t k,
+                                      const Matrix<T, Row, Col> &matrix) {
+  for (size_t r = 0; r != Row; ++r)
+    for (size_t c = 0; c != Col; ++c) this->at(k, r, c) = matrix[r][c];
+}
+
+template <typename T, size_t Row, size_t Col, size_t Lane> void
+MatrixBatch<T, Row, Col, Lane>::load(size_t k, Vector<T, Col> &vector) const {
+  if (Row != 1) throw std::invalid_argument("MatrixBatch::load");
+  for (size_t c = 0; c != Col; ++c) vector[c] = this->at(k, 0, c);
+}
+
+template <typename T, size_t Row, size_t Col, size_t Lane> void
+MatrixBatch<T, Row, Col, Lane>::store(size_t k, const Vector<T, Col> &vector) {
+  if (Row != 1) throw std::invalid_argument("MatrixBatch::store");
+  for (size_t c = 0; c != Col; ++c) this->at(k, 0, c) = vector[c];
+}
+
+template <typename T, size_t Row, size_t Col, size_t Lane> size_t
+MatrixBatch<T, Row, Col, Lane>::groups() const {
+  return this->value.size() / (Row * Col * Lane);
+}
+
+template <typename T, size_t Row, size_t Col, size_t Lane> T *
+MatrixBatch<T, Row, Col, Lane>::group(size_t g) {
+  return &this->value[g * Row * Col * Lane];
+}
+
+template <typename T, size_t Row, size_t Col, size_t Lane> const T *
+MatrixBatch<T, Row, Col, Lane>::group(size_t g) const {
+  return &this->value[g * Row * Col * Lane];
+}
+
+// Column c of the len x width group a (and the len x len group e, if any),
+// as triangularize_ with FirstNonZeroPivot lane by lane: the first row
+// from c on whose element is not zero is swapped to row c, in every lane.
+// Lanes without such a row are marked singular and left alone, and
+// swapped flips for the lanes whose rows are swapped.
+template <typename T, size_t Row, size_t Col, size_t Lane> void
+MatrixBatch<T, Row, Col, Lane>::pivot_(T *a, T *e, size_t c, size_t width,
+                                       bool *singular, bool *swapped) {
+  const size_t len = Row;
+  size_t pivot[Lane];
+  for (size_t k = 0; k != Lane; ++k) pivot[k] = len;
+  for (size_t i = c; i != len; ++i)
+    for (size_t k = 0; k != Lane; ++k)
+      if (pivot[k] == len && !isZero(a[(i * width + c) * Lane + k]))
+        pivot[k] = i;
+  for (size_t k = 0; k != Lane; ++k) {
+    if (pivot[k] == len) singular[k] = true, pivot[k] = c;
+    if (pivot[k] != c) swapped[k] = !swapped[k];
+  }
+  for (size_t i = c + 1; i != len; ++i)
+    for (size_t j = 0; j != width; ++j) {
+      T *const x = a + (c * width + j) * Lane;
+      T *const y = a + (i * width + j) * Lane;
+      for (size_t k = 0; k != Lane; ++k) {
+        const T t = pivot[k] == i ? y[k] : x[k];
+        y[k] = pivot[k] == i ? x[k] : y[k];
+        x[k] = t;
+      }
+      if (!e) continue;
+      T *const u = e + (c * width + j) * Lane;
+      T *const v = e + (i * width + j) * Lane;
+      for (size_t k = 0; k != Lane; ++k) {
+        const T t = pivot[k] == i ? v[k] : u[k];
+        v[k] = pivot[k] == i ? u[k] : v[k];
+        u[k] = t;
+      }
+    }
+}
+
+// Writes size() determinants to result.
+template <typename T, size_t Row, size_t Col, size_t Lane> void
+MatrixBatch<T, Row, Col, Lane>::determinant(T *result) const {
+  if (Row != Col) throw std::invalid_argument("MatrixBatch::determinant");
+  const size_t len = Row, groups = this->groups();
+  T a[Row * Col * Lane], f[Lane];
+  for (size_t g = 0; g != groups; ++g) {
+    const T *const source = this->group(g);
+    bool singular[Lane] = {}, swapped[Lane] = {};
+    for (size_t i = 0; i != len * len * Lane; ++i) a[i] = source[i];
+    for (size_t c = 0; c != len; ++c) {
+      this->pivot_(a, NULL, c, len, singular, swapped);
+      const T *const p = a + (c * len + c) * Lane;
+      for (size_t k = 0; k != Lane; ++k)
+        f[k] = T(1) / (singular[k] ? T(1) : p[k]);
+      for (size_t i = c + 1; i != len; ++i) {
+        T h[Lane];
+        for (size_t k = 0; k != Lane; ++k)
+          h[k] = a[(i * len + c) * Lane + k] * f[k];
+        for (size_t j = c + 1; j != len; ++j) {
+          T *const x = a + (i * len + j) * Lane;
+          const T *const y = a + (c * len + j) * Lane;
+          for (size_t k = 0; k != Lane; ++k) x[k] -= y[k] * h[k];
+        }
+      }
+    }
+    for (size_t k = 0; k != Lane && g * Lane + k != this->size_; ++k) {
+      T det = swapped[k] ? -1 : 1;
+      for (size_t i = 0; i != len; ++i) det *= a[(i * len + i) * Lane + k];
+      result[g * Lane + k] = singular[k] || isZero(det) ? T(0) : det;
+    }
+  }
+}
+
+// Gauss-Jordan on [A | I], lane by lane.
+template <typename T, size_t Row, size_t Col, size_t Lane>
+MatrixBatch<T, Row, Col, Lane> &
+MatrixBatch<T, Row, Col, Lane>::inverse() {
+  if (Row != Col) throw std::invalid_argument("MatrixBatch::inverse");
+  const size_t len = Row, groups = this->groups();
+  T a[Row * Col * Lane], f[Lane];
+  for (size_t g = 0; g != groups; ++g) {
+    T *const e = this->group(g);
+    bool singular[Lane] = {}, swapped[Lane] = {};
+    for (size_t i = 0; i != len * len * Lane; ++i) a[i] = e[i], e[i] = T(0);
+    for (size_t i = 0; i != len; ++i)
+      for (size_t k = 0; k != Lane; ++k) e[(i * len + i) * Lane + k] = T(1);
+    for (size_t c = 0; c != len; ++c) {
+      this->pivot_(a, e, c, len, singular, swapped);
+      T *const p = a + c * len * Lane, *const q = e + c * len * Lane;
+      for (size_t k = 0; k != Lane; ++k)
+        f[k] = singular[k] ? T(0) : T(1) / p[c * Lane + k];
+      for (size_t j = 0; j != len * Lane; ++j)
+        p[j] *= f[j % Lane], q[j] *= f[j % Lane];
+      for (size_t i = 0; i != len; ++i) {
+        if (i == c) continue;
+        T *const x = a + i * len * Lane, *const y = e + i * len * Lane;
+        for (size_t k = 0; k != Lane; ++k) f[k] = x[c * Lane + k];
+        for (size_t j = 0; j != len * Lane; ++j)
+          x[j] -= p[j] * f[j % Lane], y[j] -= q[j] * f[j % Lane];
+      }
+    }
+    for (size_t k = 0; k != Lane; ++k)
+      if (singular[k])
+        for (size_t i = 0; i != len * len; ++i) e[i * Lane + k] = T(0);
+  }
+  return *this;
+}
+
+// result = lhs * rhs matrix by matrix, result may be lhs or rhs.
+// Throws std::invalid_argument if the sizes do not match.
+template <typename T, size_t Row, size_t Mid, size_t Col, size_t Lane> void
+multiply(const MatrixBatch<T, Row, Mid, Lane> &lhs,
+         const MatrixBatch<T, Mid, Col, Lane> &rhs,
+         MatrixBatch<T, Row, Col, Lane> &result) {
+  if (lhs.size() != rhs.size())
+    throw std::invalid_argument("MatrixBatch::multiply");
+  result.resize(lhs.size());
+  T block[Row * Col * Lane];
+  for (size_t g = 0; g != lhs.groups(); ++g) {
+    const T *const a = lhs.group(g), *const b = rhs.group(g);
+    for (size_t i = 0; i != Row * Col * Lane; ++i) block[i] = T(0);
+    for (size_t r = 0; r != Row; ++r)
+      for (size_t m = 0; m != Mid; ++m) {
+        const T *const x = a + (r * Mid + m) * Lane;
+        for (size_t c = 0; c != Col; ++c) {
+          T *const z = block + (r * Col + c) * Lane;
+          const T *const y = b + (m * Col + c) * Lane;
+          for (size_t k = 0; k != Lane; ++k) z[k] += x[k] * y[k];
+        }
+      }
+    T *const z = result.group(g);
+    for (size_t i = 0; i != Row * Col * Lane; ++i) z[i] = block[i];
+  }
+}
+
+// Every matrix (or vector) of lhs times the same rhs.
+template <typename T, size_t Row, size_t Mid, size_t Col, size_t Lane> void
+multiply(const MatrixBatch<T, Row, Mid, Lane> &lhs,
+         const Matrix<T, Mid, Col> &rhs,
+         MatrixBatch<T, Row, Col, Lane> &result) {
+  result.resize(lhs.size());
+  T block[Row * Col * Lane];
+  for (size_t g = 0; g != lhs.groups(); ++g) {
+    const T *const a = lhs.group(g);
+    for (size_t i = 0; i != Row * Col * Lane; ++i) block[i] = T(0);
+    for (size_t r = 0; r != Row; ++r)
+      for (size_t m = 0; m != Mid; ++m) {
+        const T *const x = a + (r * Mid + m) * Lane;
+        for (size_t c = 0; c != Col; ++c) {
+          T *const z = block + (r * Col + c) * Lane;
+          const T y = rhs[m][c];
+          for (size_t k = 0; k != Lane; ++k) z[k] += x[k] * y;
+        }
+      }
+    T *const z = result.group(g);
+    for (size_t i = 0; i != Row * Col * Lane; ++i) z[i] = block[i];
+  }
+}
+
+// The same lhs times every matrix of rhs.
+template <typename T, size_t Row, size_t Mid, size_t Col, size_t Lane> void
+multiply(const Matrix<T, Row, Mid> &lhs,
+         const MatrixBatch<T, Mid, Col, Lane> &rhs,
+         MatrixBatch<T, Row, Col, Lane> &result) {
+  result.resize(rhs.size());
+  T block[Row * Col * Lane];
+  for (size_t g = 0; g != rhs.groups(); ++g) {
+    const T *const b = rhs.group(g);
+    for (size_t i = 0; i != Row * Col * Lane; ++i) block[i] = T(0);
+    for (size_t r = 0; r != Row; ++r)
+      for (size_t m = 0; m != Mid; ++m) {
+        const T x = lhs[r][m];
+        for (size_t c = 0; c != Col; ++c) {
+          T *const z = block + (r * Col + c) * Lane;
+          const T *const y = b + (m * Col + c) * Lane;
+          for (size_t k = 0; k != Lane; ++k) z[k] += x * y[k];
+        }
+      }
+    T *const z = result.group(g);
+    for (size_t i = 0; i != Row * Col * Lane; ++i) z[i] = block[i];
+  }
+}
+
+template <typename T, size_t Row, size_t Mid, size_t Col, size_t Lane>
+MatrixBatch<T, Row, Col, Lane>
+operator*(const MatrixBatch<T, Row, Mid, Lane> &lhs,
+          const MatrixBatch<T, Mid, Col, Lane> &rhs) {
+  MatrixBatch<T, Row, Col, Lane> result;
+  multiply(lhs, rhs, result);
+  return result;
+}
+
+template <typename T, size_t Row, size_t Mid, size_t Col, size_t Lane>
+MatrixBatch<T, Row, Col, Lane>
+operator*(const MatrixBatch<T, Row, Mid, Lane> &lhs,
+          const Matrix<T, Mid, Col> &rhs) {
+  MatrixBatch<T, Row, Col, Lane> result;
+  multiply(lhs, rhs, result);
+  return result;
+}
+
+template <typename T, size_t Row, size_t Mid, size_t Col, size_t Lane>
+MatrixBatch<T, Row, Col, Lane>
+operator*(const Matrix<T, Row, Mid> &lhs,
+          const MatrixBatch<T, Mid, Col, Lane> &rhs) {
+  MatrixBatch<T, Row, Col, Lane> result;
+  multiply(lhs, rhs, result);
+  return result;
+}
@@ -1,6 +1,11 @@
 #pragma once
 
 #include <algorithm>  // std::abs
+#include <cmath>  // std::sqrt
+#include <cstddef>  // ptrdiff_t
+#include <limits>
+#include <stdexcept>
+#include <vector>
 
 template <typename T, size_t Row = 0, size_t Col = 0> class Matrix;
 
@@ -8,6 +13,14 @@ template <typename T, size_t Row = 0, size_t Col = 0> class Matrix;
 template <typename T, size_t Row> class Matrix<T, Row, 0>;
 template <typename T, size_t Col> class Matrix<T, 0, Col>;
 
+// constexpr since C++14, which allows loops and assignments in it, so that
+// fix-sized matrices can be computed at compile time. Empty before.
+#if __cplusplus >= 201402L
+#define MATRIX_CONSTEXPR constexpr
+#else
+#define MATRIX_CONSTEXPR
+#endif  // __cplusplus >= 201402L
+
 template <typename T>
 inline bool isZero(T value) {
   return value == T(0);
@@ -39,22 +52,274 @@ void ifCpp11MoveElseCopy(InputIter begin, InputIter end, InputIter dest) {
            (begin, end, dest);
 }
 
+// The bytes a matrix or a MatrixView touches, to tell whether writing one
+// of them changes the other while it is being read.
+struct MatrixSpan {
+  const char *begin, *end, *first;
+  ptrdiff_t rowStride, colStride;
+
+  bool overlaps(const MatrixSpan &that) const {
+    return this->begin < that.end && that.begin < this->end;
+  }
+  // Element (r, c) of both is at the same address.
+  bool sameAs(const MatrixSpan &that) const {
+    return this->first == that.first && this->rowStride == that.rowStride
+        && this->colStride == that.colStride;
+  }
+};
+
+template <typename M> MatrixSpan
+spanOf_(const M &matrix) {
+  MatrixSpan span = { NULL, NULL, NULL, 0, 0 };
+  if (!matrix.row() || !matrix.col()) return span;
+  const size_t row = matrix.row(), col = matrix.col();
+  span.first = span.begin = reinterpret_cast<const char *>(&matrix[0][0]);
+  span.end = reinterpret_cast<const char *>(&matrix[row - 1][col - 1] + 1);
+  span.colStride = col == 1 ? 0 : reinterpret_cast<const char *>(
+      &matrix[0][1]) - span.first;
+  span.rowStride = row == 1 ? 0 : reinterpret_cast<const char *>(
+      &matrix[1][0]) - span.first;
+  return span;
+}
+
+// Element type of the rows below, T * or MatrixViewRow<T>.
+template <typename Row>
+struct RowTraits_ {
+  typedef typename Row::Value Value;
+};
+
+template <typename T>
+struct RowTraits_<T *> {
+  typedef T Value;
+};
+
+// Pivoting policies of triangularize_ and inverse_. Each one has
+//   swapsColumns           whether it may pick a pivot off column c;
+//   init(matrix, row, col) called once before the elimination;
+//   swapped(i, j)          called when rows i and j are swapped;
+//   find(matrix, r, c, row, col, p, q)
+//                          the pivot (p, q) of the submatrix from (r, c),
+//                          false if there is none (in column c only, unless
+//                          swapsColumns).
+// FirstNonZeroPivot is the cheapest and exact for exact types. The others
+// pick large pivots to keep the rounding errors of float and double down:
+// PartialPivot the largest of the column, ScaledPartialPivot the largest
+// relative to its row, CompletePivot the largest of the submatrix and
+// RookPivot one which is the largest of both its row and its column.
+template <typename T> T
+pivotMagnitude_(const T &value) {
+  return value < T(0) ? T(0) - value : value;
+}
+
+struct FirstNonZeroPivot {
+  static const bool swapsColumns = false;
+  template <typename Row> void init(Row *, size_t, size_t) {}
+  void swapped(size_t, size_t) {}
+  template <typename Row> bool
+  find(Row *matrix, size_t r, size_t c, size_t row, size_t,
+       size_t &p, size_t &q) const {
+    for (p = r, q = c; p != row; ++p)
+      if (!isZero(matrix[p][c])) return true;
+    return false;
+  }
+};
+
+struct PartialPivot {
+  static const bool swapsColumns = false;
+  template <typename Row> void init(Row *, size_t, size_t) {}
+  void swapped(size_t, size_t) {}
+  template <typename Row> bool
+  find(Row *matrix, size_t r, size_t c, size_t row, size_t,
+       size_t &p, size_t &q) const {
+    typedef typename RowTraits_<Row>::Value T;
+    T best = T(0);
+    p = r, q = c;
+    for (size_t i = r; i != row; ++i) {
+      const T m = pivotMagnitude_(matrix[i][c]);
+      if (best < m) best = m, p = i;
+    }
+    return !isZero(best);
+  }
+};
+
+// Implicit scaling: each row counts relative to its largest magnitude in
+// the original matrix, so scaling a row does not change the pivots.
+template <typename T>
+class ScaledPartialPivot {
+ public:
+  static const bool swapsColumns = false;
+  template <typename Row> void init(Row *matrix, size_t row, size_t col) {
+    this->scale_.assign(row, T(0));
+    for (size_t i = 0; i != row; ++i)
+      for (size_t j = 0; j != col; ++j)
+        if (this->scale_[i] < pivotMagnitude_(matrix[i][j]))
+          this->scale_[i] = pivotMagnitude_(matrix[i][j]);
+  }
+  void swapped(size_t i, size_t j) {
+    std::swap(this->scale_[i], this->scale_[j]);
+  }
+  template <typename Row> bool
+  find(Row *matrix, size_t r, size_t c, size_t row, size_t,
+       size_t &p, size_t &q) const {
+    T best = T(0);
+    bool found = false;
+    p = r, q = c;
+    for (size_t i = r; i != row; ++i) {
+      // Only a row of exact zeros is passed over, the others are judged
+      // by their scaled magnitudes.
+      if (this->scale_[i] == T(0)) continue;
+      const T m = pivotMagnitude_(matrix[i][c]) / this->scale_[i];
+      if (isZero(m)) continue;
+      if (!found || best < m) best = m, p = i, found = true;
+    }
+    return found;
+  }
+
+ private:
+  std::vector<T> scale_;
+};
+
+struct CompletePivot {
+  static const bool swapsColumns = true;
+  template <typename Row> void init(Row *, size_t, size_t) {}
+  void swapped(size_t, size_t) {}
+  template <typename Row> bool
+  find(Row *matrix, size_t r, size_t c, size_t row, size_t col,
+       size_t &p, size_t &q) const {
+    typedef typename RowTraits_<Row>::Value T;
+    T best = T(0);
+    p = r, q = c;
+    for (size_t i = r; i != row; ++i)
+      for (size_t j = c; j != col; ++j) {
+        const T m = pivotMagnitude_(matrix[i][j]);
+        if (best < m) best = m, p = i, q = j;
+      }
+    return !isZero(best);
+  }
+};
+
+// Alternates between the largest of a column and of a row until neither
+// moves, usually a couple of scans, as stable as complete pivoting in
+// practice for the cost of partial pivoting.
+struct RookPivot {
+  static const bool swapsColumns = true;
+  template <typename Row> void init(Row *, size_t, size_t) {}
+  void swapped(size_t, size_t) {}
+  template <typename Row> bool
+  find(Row *matrix, size_t r, size_t c, size_t row, size_t col,
+       size_t &p, size_t &q) const {
+    typedef typename RowTraits_<Row>::Value T;
+    T best = T(0);
+    // Starts from the largest of the first column with a nonzero below r.
+    for (p = r, q = c; q != col; ++q) {
+      best = T(0);
+      for (size_t i = r; i != row; ++i) {
+        const T m = pivotMagnitude_(matrix[i][q]);
+        if (best < m) best = m, p = i;
+      }
+      if (!isZero(best)) break;
+    }
+    if (q == col) return false;
+    for (bool inRow = true; ; inRow = !inRow) {
+      const size_t p0 = p, q0 = q;
+      if (inRow) {
+        for (size_t j = c; j != col; ++j)
+          if (best < pivotMagnitude_(matrix[p0][j]))
+            best = pivotMagnitude_(matrix[p0][j]), q = j;
+      } else {
+        for (size_t i = r; i != row; ++i)
+          if (best < pivotMagnitude_(matrix[i][q0]))
+            best = pivotMagnitude_(matrix[i][q0]), p = i;
+      }
+      if (p == p0 && q == q0) return true;
+    }
+  }
+};
+
+// First nonzero for exact types, partial pivoting for floating points.
+template <typename T>
+struct DefaultPivot_ {
+  typedef FirstNonZeroPivot type;
+};
+
+template <>
+struct DefaultPivot_<float> {
+  typedef PartialPivot type;
+};
+
+template <>
+struct DefaultPivot_<double> {
+  typedef PartialPivot type;
+};
+
+template <>
+struct DefaultPivot_<long double> {
+  typedef PartialPivot type;
+};
+
+// The pivots of echelon_, which tell the rank as well. A column of small
+// floating points is not zero there, so they are scaled by their rows.
+template <typename T>
+struct EchelonPivot_ {
+  typedef typename DefaultPivot_<T>::type type;
+};
+
+template <>
+struct EchelonPivot_<float> {
+  typedef ScaledPartialPivot<float> type;
+};
+
+template <>
+struct EchelonPivot_<double> {
+  typedef ScaledPartialPivot<double> type;
+};
+
+template <>
+struct EchelonPivot_<long double> {
+  typedef ScaledPartialPivot<long double> type;
+};
+
+// sizeof an incomplete type does not compile, which stands for
+// static_assert in C++98: triangularize and eliminate cannot undo the
+// column swaps of CompletePivot and RookPivot.
+template <bool> struct PivotKeepsColumns_;
+template <> struct PivotKeepsColumns_<true> {};
+
 // The following two functions should be private and never invoked directly.
 // They were originally static member function of Matrix<T>.
 // However I tries to decoupling Matrix<T> (variable-sized matrix) and
 // Matrix<T, Row, Col> (fix-sized matrix).
 // To prevent inclusion (and specialization) from fix-sized matrix to
 // variable-sized matrix, I declare and defined the two functions here.
-template <typename T> bool
-triangularize_(T **matrix, const size_t row, const size_t col) {
+// Rows are swapped through the pointers, columns (if pivot swapsColumns)
+// for real, then columns[j], if not NULL, is the original index of column
+// j. Returns whether the number of swaps is even.
+template <typename Row, typename Pivot> bool
+triangularize_(Row *matrix, const size_t row, const size_t col,
+               Pivot &pivot, size_t *columns) {
+  typedef typename RowTraits_<Row>::Value T;
   using std::swap;
   bool swapped = true;
+  if (columns) for (size_t j = 0; j != col; ++j) columns[j] = j;
+  pivot.init(matrix, row, col);
   for (size_t r = 0, c = 0; r != row && c != col; ++c) {
-    size_t pivot = ~static_cast<size_t>(0);
-    for (size_t i = r; !~pivot && i != row; ++i)
-      if (!isZero(matrix[i][c])) pivot = i;
-    if (pivot == ~static_cast<size_t>(0)) continue;
-    swap(matrix[pivot], matrix[r++]); swapped ^= 1;
+    size_t p, q;
+    if (!pivot.find(matrix, r, c, row, col, p, q)) {
+      // What the policy takes for zero is set to zero, so that a singular
+      // matrix has an exact zero on the diagonal.
+      const size_t end = Pivot::swapsColumns ? col : c + 1;
+      for (size_t i = r; i != row; ++i)
+        for (size_t j = c; j != end; ++j) matrix[i][j] = 0;
+      if (Pivot::swapsColumns) break;
+      continue;
+    }
+    if (q != c) {
+      swapped ^= 1;
+      for (size_t i = 0; i != row; ++i) swap(matrix[i][q], matrix[i][c]);
+      if (columns) swap(columns[q], columns[c]);
+    }
+    if (p != r) swapped ^= 1, pivot.swapped(p, r);
+    swap(matrix[p], matrix[r++]);
     for (size_t i = r; i != row; ++i) {
       T f = matrix[i][c] / matrix[r - 1][c];
       for (size_t j = c + 1; j != col; ++j)
@@ -65,8 +330,14 @@ triangularize_(T **matrix, const size_t row, const size_t col) {
   return swapped;
 }
 
-template <typename T> void
-canonicalize_(T **matrix, const size_t row, const size_t col) {
+template <typename Row> bool
+triangularize_(Row *matrix, const size_t row, const size_t col) {
+  typename DefaultPivot_<typename RowTraits_<Row>::Value>::type pivot;
+  return triangularize_(matrix, row, col, pivot, NULL);
+}
+
+template <typename Row> void
+canonicalize_(Row *matrix, const size_t row, const size_t col) {
   for (size_t r = row - 1, c; ~r; --r) {
     for (c = 0; c != col && isZero(matrix[r][c]); ++c);
     if (c == col) continue;
@@ -80,3 +351,289 @@ canonicalize_(T **matrix, const size_t row, const size_t col) {
     }
   }
 }
+
+// Moves the rows pointed by matrix into their natural places, so that the
+// i-th row of the storage starting at base (rows are stride apart) holds
+// what matrix[i] pointed to. Each cycle of the permutation is followed with
+// row swaps, thus no extra storage is needed. matrix is reset on return.
+template <typename T> void
+permuteRows_(T **matrix, T *const base,
+             const size_t row, const size_t col, const size_t stride) {
+  for (size_t i = 0; i != row; ++i)
+    for (size_t j = i; matrix[j] != base + j * stride; ) {
+      const size_t k = (matrix[j] - base) / stride;
+      matrix[j] = base + j * stride;
+      if (k == i) break;
+      std::swap_ranges(matrix[j], matrix[j] + col, base + k * stride);
+      j = k;
+    }
+}
+
+// In-place Gauss-Jordan inversion of a len x len matrix, no augmented
+// matrix is needed. Rows are swapped through the pointers only, call
+// permuteRows_ afterwards. pivot is a buffer of len elements.
+// The pivots are chosen by DefaultPivot_, which never swaps columns.
+// Returns false (leaving the matrix in a mess) if not inversible.
+template <typename Row> bool
+inverse_(Row *matrix, const size_t len, size_t *pivot) {
+  typedef typename RowTraits_<Row>::Value T;
+  using std::swap;
+  typename DefaultPivot_<T>::type policy;
+  for (size_t c = 0; c != len; ++c) {
+    size_t p, q;
+    if (!policy.find(matrix, c, c, len, len, p, q)) return false;
+    swap(matrix[pivot[c] = p], matrix[c]);
+    const Row r = matrix[c];
+    const T f = T(1) / r[c];
+    r[c] = 1;
+    for (size_t j = 0; j != len; ++j) r[j] *= f;
+    for (size_t i = 0; i != len; ++i) {
+      if (i == c || isZero(matrix[i][c])) continue;
+      const T g = matrix[i][c];
+      matrix[i][c] = 0;
+      for (size_t j = 0; j != len; ++j)
+        matrix[i][j] -= r[j] * g;
+    }
+  }
+  // inverse(PA) * P is inverse(A), P permutes columns from the right.
+  for (size_t c = len - 1; ~c; --c)
+    if (pivot[c] != c)
+      for (size_t i = 0; i != len; ++i)
+        swap(matrix[i][c], matrix[i][pivot[c]]);
+  return true;
+}
+
+// Reduces a len x len matrix to upper Hessenberg form by similarity, i.e.
+// Gaussian elimination below the subdiagonal, undoing each row operation
+// on the columns so that the eigenvalues stay. Rows are swapped for real
+// since the columns go with them.
+template <typename Row> void
+hessenberg_(Row *matrix, const size_t len) {
+  typedef typename RowTraits_<Row>::Value T;
+  using std::swap;
+  for (size_t c = 0; c + 2 < len; ++c) {
+    size_t p = c + 1;
+    while (p != len && isZero(matrix[p][c])) ++p;
+    if (p == len) continue;
+    if (p != c + 1) {
+      for (size_t j = c; j != len; ++j) swap(matrix[p][j], matrix[c + 1][j]);
+      for (size_t i = 0; i != len; ++i) swap(matrix[i][p], matrix[i][c + 1]);
+    }
+    const Row r = matrix[c + 1];
+    for (size_t i = c + 2; i != len; ++i) {
+      if (isZero(matrix[i][c])) continue;
+      const T f = matrix[i][c] / r[c];
+      for (size_t j = c + 1; j != len; ++j) matrix[i][j] -= r[j] * f;
+      matrix[i][c] = 0;
+      for (size_t k = 0; k != len; ++k) matrix[k][c + 1] += matrix[k][i] * f;
+    }
+  }
+}
+
+// det(xI - A) of a len x len matrix, destroying it, as len + 1
+// coefficients from the constant term up, in O(len^3). poly is a buffer of
+// (len + 1)^2 elements, the characteristic polynomials of the leading
+// principal submatrices of the Hessenberg form are put in turn, the last
+// one being the result.
+template <typename Row> typename RowTraits_<Row>::Value *
+characteristicPolynomial_(Row *matrix, const size_t len,
+                          typename RowTraits_<Row>::Value *poly) {
+  typedef typename RowTraits_<Row>::Value T;
+  hessenberg_(matrix, len);
+  const size_t size = len + 1;
+  std::fill(poly, poly + size * size, T(0));
+  poly[0] = 1;
+  for (size_t k = 0; k != len; ++k) {
+    // p_k+1 = (x - h_kk) p_k - sum h_ik h_i+1,i ... h_k,k-1 p_i.
+    T *const next = poly + (k + 1) * size;
+    const T *const last = poly + k * size;
+    for (size_t j = 0; j <= k; ++j) {
+      next[j + 1] += last[j];
+      next[j] -= matrix[k][k] * last[j];
+    }
+    T product = 1;
+    for (size_t i = k - 1; ~i; --i) {
+      product *= matrix[i + 1][i];
+      if (isZero(product)) break;
+      const T f = matrix[i][k] * product;
+      const T *const p = poly + i * size;
+      for (size_t j = 0; j <= i; ++j) next[j] -= f * p[j];
+    }
+  }
+  return poly + len * size;
+}
+
+// Row echelon form through the row pointers with the pivot columns put in
+// pivots, reduced (pivots 1, zeros above them) as well if reduce. Unlike
+// triangularize_ and canonicalize_, the pivots are recorded on the way, so
+// nothing is scanned again. Returns the rank.
+template <typename Row> size_t
+echelon_(Row *matrix, const size_t row, const size_t col, size_t *pivots,
+         bool reduce) {
+  typedef typename RowTraits_<Row>::Value T;
+  using std::swap;
+  typename EchelonPivot_<T>::type policy;
+  policy.init(matrix, row, col);
+  size_t rank = 0;
+  for (size_t c = 0; rank != row && c != col; ++c) {
+    size_t p, q;
+    if (!policy.find(matrix, rank, c, row, col, p, q)) continue;
+    if (p != rank) swap(matrix[p], matrix[rank]), policy.swapped(p, rank);
+    const Row r = matrix[rank];
+    const T f = T(1) / r[c];
+    r[c] = 1;
+    for (size_t j = c + 1; j != col; ++j) r[j] *= f;
+    for (size_t i = rank + 1; i != row; ++i) {
+      if (matrix[i][c] == T(0)) continue;
+      const T g = matrix[i][c];
+      matrix[i][c] = 0;
+      for (size_t j = c + 1; j != col; ++j) matrix[i][j] -= r[j] * g;
+    }
+    pivots[rank++] = c;
+  }
+  for (size_t k = rank - 1; reduce && ~k; --k) {
+    const size_t c = pivots[k];
+    for (size_t i = 0; i != k; ++i) {
+      if (matrix[i][c] == T(0)) continue;
+      const T g = matrix[i][c];
+      matrix[i][c] = 0;
+      for (size_t j = c + 1; j != col; ++j) matrix[i][j] -= matrix[k][j] * g;
+    }
+  }
+  return rank;
+}
+
+// A copy of matrix with extra zero columns, for echelon_.
+template <typename M, typename T> void
+echelonCopy_(const M &matrix, size_t extra, std::vector<T> &value,
+             std::vector<T *> &rows) {
+  const size_t row = matrix.row(), col = matrix.col(), width = col + extra;
+  value.assign(row * width + 1, T(0));
+  rows.resize(row + 1);
+  for (size_t r = 0; r != row; ++r) {
+    rows[r] = &value[r * width];
+    for (size_t c = 0; c != col; ++c) rows[r][c] = matrix[r][c];
+  }
+}
+
+// The following are shared by the rank(), pivotColumns(), nullspace(),
+// solve() and leastSquares() of the matrices.
+template <typename T, typename M> size_t
+rankOf_(const M &matrix) {
+  std::vector<T> value;
+  std::vector<T *> rows;
+  std::vector<size_t> pivots(matrix.col() + 1);
+  echelonCopy_(matrix, 0, value, rows);
+  return echelon_(&rows[0], matrix.row(), matrix.col(), &pivots[0], false);
+}
+
+template <typename T, typename M> std::vector<size_t>
+pivotColumnsOf_(const M &matrix) {
+  std::vector<T> value;
+  std::vector<T *> rows;
+  std::vector<size_t> pivots(matrix.col() + 1);
+  echelonCopy_(matrix, 0, value, rows);
+  pivots.resize(echelon_(&rows[0], matrix.row(), matrix.col(),
+                         &pivots[0], false));
+  return pivots;
+}
+
+// A basis of {x | A x = 0}, one vector per free column of the reduced
+// echelon form: 1 at the free column, minus that column at the pivots.
+template <typename T, typename M> std::vector<std::vector<T> >
+nullspaceOf_(const M &matrix) {
+  const size_t row = matrix.row(), col = matrix.col();
+  std::vector<T> value;
+  std::vector<T *> rows;
+  std::vector<size_t> pivots(col + 1);
+  echelonCopy_(matrix, 0, value, rows);
+  const size_t rank = echelon_(&rows[0], row, col, &pivots[0], true);
+  std::vector<std::vector<T> > basis;
+  basis.reserve(col - rank);
+  for (size_t c = 0, k = 0; c != col; ++c) {
+    if (k != rank && pivots[k] == c) {
+      ++k;
+      continue;
+    }
+    basis.push_back(std::vector<T>(col, T(0)));
+    std::vector<T> &v = basis.back();
+    v[c] = 1;
+    for (size_t i = 0; i != k; ++i) v[pivots[i]] = T(0) - rows[i][c];
+  }
+  return basis;
+}
+
+// Some x with A x = b, zero at the free columns, from the reduced echelon
+// form of [A | b]. Returns false, leaving x alone, if there is none.
+// Throws std::invalid_argument if b is not of A.row() elements.
+template <typename T, typename M> bool
+solveOf_(const M &matrix, const std::vector<T> &b, std::vector<T> &x) {
+  const size_t row = matrix.row(), col = matrix.col();
+  if (b.size() != row) throw std::invalid_argument("Matrix::solve");
+  std::vector<T> value;
+  std::vector<T *> rows;
+  std::vector<size_t> pivots(col + 2);
+  echelonCopy_(matrix, 1, value, rows);
+  for (size_t r = 0; r != row; ++r) rows[r][col] = b[r];
+  const size_t rank = echelon_(&rows[0], row, col + 1, &pivots[0], true);
+  if (rank && pivots[rank - 1] == col) return false;
+  x.assign(col, T(0));
+  for (size_t k = 0; k != rank; ++k) x[pivots[k]] = rows[k][col];
+  return true;
+}
+
+// argmin |A x - b| by Householder QR, for float and double: better
+// conditioned than the normal equations A^T A x = A^T b.
+// Throws std::invalid_argument if b is not of A.row() elements, or if A
+// has fewer rows than columns or is numerically rank deficient: some
+// reflected diagonal |r_kk| is below eps row max_j |a_j|.
+template <typename T, typename M> std::vector<T>
+leastSquaresOf_(const M &matrix, const std::vector<T> &b) {
+  const size_t row = matrix.row(), col = matrix.col();
+  if (b.size() != row || row < col)
+    throw std::invalid_argument("Matrix::leastSquares");
+  std::vector<T> value, y(b);
+  std::vector<T *> rows;
+  echelonCopy_(matrix, 0, value, rows);
+  std::vector<T> v(row + 1), diagonal(col + 1);
+  // Reflections keep column norms, so the largest one bounds every r_kk.
+  T largest = T(0);
+  for (size_t k = 0; k != col; ++k) {
+    T norm = T(0);
+    for (size_t i = 0; i != row; ++i) norm += rows[i][k] * rows[i][k];
+    largest = std::max(largest, norm);
+  }
+  const T tolerance = std::numeric_limits<T>::epsilon() * T(row)
+      * std::sqrt(largest);
+  for (size_t k = 0; k != col; ++k) {
+    // Reflects column k below the diagonal onto -sign(a_kk) |x| e_k.
+    T norm = T(0);
+    for (size_t i = k; i != row; ++i) norm += rows[i][k] * rows[i][k];
+    norm = std::sqrt(norm);
+    if (!(norm > tolerance))
+      throw std::invalid_argument("Matrix::leastSquares");
+    const T alpha = rows[k][k] < T(0) ? norm : T(0) - norm;
+    for (size_t i = k; i != row; ++i) v[i] = rows[i][k];
+    v[k] -= alpha;
+    // H = I - 2 v v^T / v^T v, where v^T v = 2 norm (norm + |a_kk|).
+    const T scale = T(1) / (norm * (norm + pivotMagnitude_(rows[k][k])));
+    for (size_t j = k + 1; j != col; ++j) {
+      T dot = T(0);
+      for (size_t i = k; i != row; ++i) dot += v[i] * rows[i][j];
+      dot *= scale;
+      for (size_t i = k; i != row; ++i) rows[i][j] -= v[i] * dot;
+    }
+    T dot = T(0);
+    for (size_t i = k; i != row; ++i) dot += v[i] * y[i];
+    dot *= scale;
+    for (size_t i = k; i != row; ++i) y[i] -= v[i] * dot;
+    diagonal[k] = alpha;
+  }
+  std::vector<T> x(col);
+  for (size_t k = col; k--; ) {
+    T sum = y[k];
+    for (size_t j = k + 1; j != col; ++j) sum -= rows[k][j] * x[j];
+    x[k] = sum / diagonal[k];
+  }
+  return x;
+}
@@ -0,0 +1,351 @@
+#pragma once
+
+// Lazy expression templates shared by Matrix<T, Row, Col> and Matrix<T>.
+// Since C++11, A + B - C builds a small tree of the nodes below instead of
+// temporary matrices, and the tree is evaluated element-wise in a single
+// pass once it is assigned to (or added to) a matrix.
+// Products are never evaluated element by element: D = A * B + C copies C
+// into D and accumulates A * B into it row by row, which is a GEMM.
+// Nodes keep references to their operands, so never let one outlive the
+// full expression, e.g. auto D = A + B; dangles as soon as A or B dies.
+
+#if __cplusplus >= 201103L
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+#include "MatrixDecl.hh"
+
+template <typename T, size_t Row, size_t Col> class MatrixLeaf;
+template <typename Lhs, typename Rhs, bool Subtract> class MatrixSum;
+template <typename Lhs, typename Rhs> class MatrixProduct;
+
+// MatrixExpressionOf<E>::type is the node wrapping E: a matrix becomes a leaf
+// and a node stays as it is. Anything else has no type, which keeps the
+// operators below out of overload resolution for scalars and vectors.
+template <typename E, typename = void>
+struct MatrixExpressionOf {
+};
+
+template <typename E>
+struct MatrixExpressionOf<E, typename E::IsMatrixExpression> {
+  typedef E type;
+  static MATRIX_CONSTEXPR const E &wrap(const E &expr) { return expr; }
+};
+
+template <typename T, size_t Row, size_t Col>
+struct MatrixExpressionOf<Matrix<T, Row, Col>, void> {
+  typedef MatrixLeaf<T, Row, Col> type;
+  static MATRIX_CONSTEXPR type wrap(const Matrix<T, Row, Col> &matrix) {
+    return type(matrix);
+  }
+};
+
+// Every node provides:
+//   row(), col()          the size of the result;
+//   at(r, c)              the element, only if coefficientWise;
+//   aliases(span)         whether the node reads memory in the span;
+//   clobbers(span)        whether evaluating straight into the span is wrong;
+//   assignTo<Negate>(m)   m = expr (or -expr);
+//   updateTo<Subtract>(m) m += expr (or -= expr);
+//   operand()             the value to keep when used as a factor.
+// The destination m is anything with m[r][c], a matrix or a MatrixView.
+template <bool Negate, typename Dest, typename Expr> MATRIX_CONSTEXPR void
+assignCoefficients_(Dest &dest, const Expr &expr) {
+  typedef typename Expr::Value T;
+  const size_t row = expr.row(), col = expr.col();
+  for (size_t r = 0; r != row; ++r) {
+    const auto d = dest[r];
+    for (size_t c = 0; c != col; ++c)
+      d[c] = Negate ? T(0) - expr.at(r, c) : expr.at(r, c);
+  }
+}
+
+template <bool Subtract, typename Dest, typename Expr> MATRIX_CONSTEXPR void
+updateCoefficients_(Dest &dest, const Expr &expr) {
+  const size_t row = expr.row(), col = expr.col();
+  for (size_t r = 0; r != row; ++r) {
+    const auto d = dest[r];
+    for (size_t c = 0; c != col; ++c)
+      if (Subtract) d[c] -= expr.at(r, c); else d[c] += expr.at(r, c);
+  }
+}
+
+// dest += lhs * rhs (or -=), streaming along the rows of rhs and dest.
+template <bool Subtract, typename Dest, typename Lhs, typename Rhs>
+MATRIX_CONSTEXPR void
+multiplyAccumulate_(Dest &dest, const Lhs &lhs, const Rhs &rhs) {
+  typedef typename std::decay<decltype(lhs[0][0])>::type T;
+  const size_t row = lhs.row(), mid = lhs.col(), col = rhs.col();
+  for (size_t r = 0; r != row; ++r) {
+    const auto d = dest[r];
+    const auto a = lhs[r];
+    for (size_t k = 0; k != mid; ++k) {
+      const T f = a[k];
+      const auto b = rhs[k];
+      for (size_t c = 0; c != col; ++c)
+        if (Subtract) d[c] -= f * b[c]; else d[c] += f * b[c];
+    }
+  }
+}
+
+template <typename T, size_t Row, size_t Col>
+class MatrixLeaf {
+ public:
+  typedef void IsMatrixExpression;
+  typedef T Value;
+  typedef Matrix<T, Row, Col> Result;
+  typedef const Result &Operand;
+  static const size_t fixedRow = Row, fixedCol = Col;
+  static const bool coefficientWise = true;
+
+  explicit MATRIX_CONSTEXPR MatrixLeaf(const Result &matrix)
+      : matrix_(matrix) {}
+
+  MATRIX_CONSTEXPR size_t row() const { return matrix_.row(); }
+  MATRIX_CONSTEXPR size_t col() const { return matrix_.col(); }
+  MATRIX_CONSTEXPR const T &at(size_t r, size_t c) const {
+    return matrix_[r][c];
+  }
+  bool aliases(const MatrixSpan &span) const {
+    return spanOf_(matrix_).overlaps(span);
+  }
+  bool clobbers(const MatrixSpan &span) const {
+    return this->aliases(span) && !spanOf_(matrix_).sameAs(span);
+  }
+  MATRIX_CONSTEXPR Operand operand() const { return matrix_; }
+
+  template <bool Negate, typename Dest>
+  MATRIX_CONSTEXPR void assignTo(Dest &dest) const {
+    assignCoefficients_<Negate>(dest, *this);
+  }
+  template <bool Subtract, typename Dest>
+  MATRIX_CONSTEXPR void updateTo(Dest &dest) const {
+    updateCoefficients_<Subtract>(dest, *this);
+  }
+
+ private:
+  const Result &matrix_;
+};
+
+// Element-wise lhs + rhs (or lhs - rhs).
+// Reading the destination is fine as long as every element is read where it
+// is written. If one side is a product, the element-wise side is written
+// first and the product is accumulated on top of it, so only the product
+// may not read the destination.
+template <typename Lhs, typename Rhs, bool Subtract>
+class MatrixSum {
+ public:
+  typedef void IsMatrixExpression;
+  typedef typename Lhs::Value Value;
+  // A fix-sized side wins over a variable-sized one, e.g. a MatrixView.
+  typedef typename std::conditional<Lhs::fixedRow != 0, typename Lhs::Result,
+                                    typename Rhs::Result>::type Result;
+  typedef Result Operand;
+  static const size_t fixedRow = Lhs::fixedRow ? Lhs::fixedRow : Rhs::fixedRow;
+  static const size_t fixedCol = Lhs::fixedCol ? Lhs::fixedCol : Rhs::fixedCol;
+  static const bool coefficientWise =
+      Lhs::coefficientWise && Rhs::coefficientWise;
+
+  MATRIX_CONSTEXPR MatrixSum(Lhs lhs, Rhs rhs)
+      : lhs_(std::move(lhs)), rhs_(std::move(rhs)) {}
+
+  MATRIX_CONSTEXPR size_t row() const { return lhs_.row(); }
+  MATRIX_CONSTEXPR size_t col() const { return lhs_.col(); }
+  MATRIX_CONSTEXPR Value at(size_t r, size_t c) const {
+    return Subtract ? lhs_.at(r, c) - rhs_.at(r, c)
+                    : lhs_.at(r, c) + rhs_.at(r, c);
+  }
+  bool aliases(const MatrixSpan &span) const {
+    return lhs_.aliases(span) || rhs_.aliases(span);
+  }
+  bool clobbers(const MatrixSpan &span) const {
+    if (coefficientWise) return lhs_.clobbers(span) || rhs_.clobbers(span);
+    return order_ == 1 ? lhs_.clobbers(span) || rhs_.aliases(span)
+                       : rhs_.clobbers(span) || lhs_.aliases(span);
+  }
+  MATRIX_CONSTEXPR Operand operand() const { return Result(*this); }
+
+  template <bool Negate, typename Dest>
+  MATRIX_CONSTEXPR void assignTo(Dest &dest) const {
+    this->assign_<Negate>(dest, std::integral_constant<int, order_>());
+  }
+  template <bool Sub, typename Dest>
+  MATRIX_CONSTEXPR void updateTo(Dest &dest) const {
+    this->update_<Sub>(dest, std::integral_constant<int, order_>());
+  }
+
+ private:
+  // 0: single element-wise pass, 1: lhs goes first, 2: rhs goes first.
+  static const int order_ = coefficientWise ? 0
+      : Lhs::coefficientWise || !Rhs::coefficientWise ? 1 : 2;
+
+  template <bool Negate, typename Dest>
+  MATRIX_CONSTEXPR void
+  assign_(Dest &dest, std::integral_constant<int, 0>) const {
+    assignCoefficients_<Negate>(dest, *this);
+  }
+  template <bool Negate, typename Dest>
+  MATRIX_CONSTEXPR void
+  assign_(Dest &dest, std::integral_constant<int, 1>) const {
+    lhs_.template assignTo<Negate>(dest);
+    rhs_.template updateTo<Negate != Subtract>(dest);
+  }
+  template <bool Negate, typename Dest>
+  MATRIX_CONSTEXPR void
+  assign_(Dest &dest, std::integral_constant<int, 2>) const {
+    rhs_.template assignTo<Negate != Subtract>(dest);
+    lhs_.template updateTo<Negate>(dest);
+  }
+  template <bool Sub, typename Dest>
+  MATRIX_CONSTEXPR void
+  update_(Dest &dest, std::integral_constant<int, 0>) const {
+    updateCoefficients_<Sub>(dest, *this);
+  }
+  template <bool Sub, typename Dest>
+  MATRIX_CONSTEXPR void
+  update_(Dest &dest, std::integral_constant<int, 1>) const {
+    lhs_.template updateTo<Sub>(dest);
+    rhs_.template updateTo<Sub != Subtract>(dest);
+  }
+  template <bool Sub, typename Dest>
+  MATRIX_CONSTEXPR void
+  update_(Dest &dest, std::integral_constant<int, 2>) const {
+    rhs_.template updateTo<Sub != Subtract>(dest);
+    lhs_.template updateTo<Sub>(dest);
+  }
+
+  Lhs lhs_;
+  Rhs rhs_;
+};
+
+// lhs * rhs. Factors which are not plain matrices are evaluated once when
+// the node is built, e.g. (A + B) * C keeps A + B as a matrix.
+template <typename Lhs, typename Rhs>
+class MatrixProduct {
+ public:
+  typedef void IsMatrixExpression;
+  typedef typename Lhs::Value Value;
+  // Variable-sized unless both sides are fix-sized.
+  static const size_t fixedRow = Rhs::fixedCol ? Lhs::fixedRow : 0;
+  static const size_t fixedCol = Lhs::fixedRow ? Rhs::fixedCol : 0;
+  typedef Matrix<Value, fixedRow, fixedCol> Result;
+  typedef Result Operand;
+  static const bool coefficientWise = false;
+
+  MATRIX_CONSTEXPR MatrixProduct(const Lhs &lhs, const Rhs &rhs)
+      : lhs_(lhs.operand()), rhs_(rhs.operand()) {}
+
+  MATRIX_CONSTEXPR size_t row() const { return lhs_.row(); }
+  MATRIX_CONSTEXPR size_t col() const { return rhs_.col(); }
+  bool aliases(const MatrixSpan &span) const {
+    return spanOf_(lhs_).overlaps(span) || spanOf_(rhs_).overlaps(span);
+  }
+  bool clobbers(const MatrixSpan &span) const { return this->aliases(span); }
+  MATRIX_CONSTEXPR Operand operand() const { return Result(*this); }
+
+  template <bool Negate, typename Dest>
+  MATRIX_CONSTEXPR void assignTo(Dest &dest) const {
+    const size_t row = this->row(), col = this->col();
+    for (size_t r = 0; r != row; ++r) {
+      const auto d = dest[r];
+      for (size_t c = 0; c != col; ++c) d[c] = Value(0);
+    }
+    this->updateTo<Negate>(dest);
+  }
+  template <bool Sub, typename Dest>
+  MATRIX_CONSTEXPR void updateTo(Dest &dest) const {
+    multiplyAccumulate_<Sub>(dest, lhs_, rhs_);
+  }
+
+ private:
+  typename Lhs::Operand lhs_;
+  typename Rhs::Operand rhs_;
+};
+
+template <bool Subtract, typename Lhs, typename Rhs>
+MATRIX_CONSTEXPR MatrixSum<Lhs, Rhs, Subtract>
+makeMatrixSum_(const Lhs &lhs, const Rhs &rhs, const char *what) {
+  static_assert(std::is_same<typename Lhs::Value,
+                             typename Rhs::Value>::value, "Type not match");
+  static_assert(!Lhs::fixedRow || !Rhs::fixedRow
+                || (Lhs::fixedRow == Rhs::fixedRow
+                    && Lhs::fixedCol == Rhs::fixedCol), "Size not match");
+  if (lhs.row() != rhs.row() || lhs.col() != rhs.col())
+    throw std::invalid_argument(what);
+  return MatrixSum<Lhs, Rhs, Subtract>(lhs, rhs);
+}
+
+// dest += expr (or -=), for matrices and views alike.
+template <bool Subtract, typename Dest, typename Expr> Dest &
+updateMatrix_(Dest &dest, const Expr &expr, const char *what) {
+  if (dest.row() != expr.row() || dest.col() != expr.col())
+    throw std::invalid_argument(what);
+  if (expr.clobbers(spanOf_(dest))) {
+    const typename Expr::Result result(expr);
+    updateCoefficients_<Subtract>(dest, MatrixExpressionOf<
+        typename Expr::Result>::wrap(result));
+  } else {
+    expr.template updateTo<Subtract>(dest);
+  }
+  return dest;
+}
+
+template <typename Lhs, typename Rhs>
+MATRIX_CONSTEXPR MatrixSum<typename MatrixExpressionOf<Lhs>::type,
+                           typename MatrixExpressionOf<Rhs>::type, false>
+operator+(const Lhs &lhs, const Rhs &rhs) {
+  return makeMatrixSum_<false>(MatrixExpressionOf<Lhs>::wrap(lhs),
+                               MatrixExpressionOf<Rhs>::wrap(rhs),
+                               "Matrix<T>::operator+");
+}
+
+template <typename Lhs, typename Rhs>
+MATRIX_CONSTEXPR MatrixSum<typename MatrixExpressionOf<Lhs>::type,
+                           typename MatrixExpressionOf<Rhs>::type, true>
+operator-(const Lhs &lhs, const Rhs &rhs) {
+  return makeMatrixSum_<true>(MatrixExpressionOf<Lhs>::wrap(lhs),
+                              MatrixExpressionOf<Rhs>::wrap(rhs),
+                              "Matrix<T>::operator-");
+}
+
+template <typename Lhs, typename Rhs>
+MATRIX_CONSTEXPR MatrixProduct<typename MatrixExpressionOf<Lhs>::type,
+                               typename MatrixExpressionOf<Rhs>::type>
+operator*(const Lhs &lhs, const Rhs &rhs) {
+  typedef typename MatrixExpressionOf<Lhs>::type L;
+  typedef typename MatrixExpressionOf<Rhs>::type R;
+  static_assert(std::is_same<typename L::Value,
+                             typename R::Value>::value, "Type not match");
+  static_assert(!L::fixedCol || !R::fixedRow || L::fixedCol == R::fixedRow,
+                "Size not match");
+  if (lhs.col() != rhs.row())
+    throw std::invalid_argument("Matrix<T>::operator*");
+  return MatrixProduct<L, R>(MatrixExpressionOf<Lhs>::wrap(lhs),
+                             MatrixExpressionOf<Rhs>::wrap(rhs));
+}
+
+// A += B * C accumulates into A without any temporary.
+// A += A is left to the plain overload of each matrix.
+template <typename T, size_t Row, size_t Col, typename Rhs,
+          typename Expr = typename MatrixExpressionOf<Rhs>::type>
+typename std::enable_if<!std::is_same<Rhs, Matrix<T, Row, Col> >::value,
+                        Matrix<T, Row, Col> &>::type
+operator+=(Matrix<T, Row, Col> &lhs, const Rhs &rhs) {
+  static_assert(std::is_same<typename Expr::Value, T>::value,
+                "Type not match");
+  return updateMatrix_<false>(lhs, MatrixExpressionOf<Rhs>::wrap(rhs),
+                              "Matrix<T>::operator+=");
+}
+
+template <typename T, size_t Row, size_t Col, typename Rhs,
+          typename Expr = typename MatrixExpressionOf<Rhs>::type>
+typename std::enable_if<!std::is_same<Rhs, Matrix<T, Row, Col> >::value,
+                        Matrix<T, Row, Col> &>::type
+operator-=(Matrix<T, Row, Col> &lhs, const Rhs &rhs) {
+  static_assert(std::is_same<typename Expr::Value, T>::value,
+                "Type not match");
+  return updateMatrix_<true>(lhs, MatrixExpressionOf<Rhs>::wrap(rhs),
+                             "Matrix<T>::operator-=");
+}
+#endif  // __cplusplus >= 201103L
@@ -0,0 +1,364 @@
+#pragma once
+
+#include <cstddef>  // ptrdiff_t
+#include <stdexcept>
+#include <vector>
+
+#include "MatrixDecl.hh"
+#include "MatrixExpression.hh"
+
+template <typename T> class MatrixView;
+
+template <typename T>
+struct MatrixViewValue_ {
+  typedef T type;
+};
+
+template <typename T>
+struct MatrixViewValue_<const T> {
+  typedef T type;
+};
+
+// One row of a MatrixView, whose elements are stride apart.
+template <typename T>
+class MatrixViewRow {
+ public:
+  typedef T Value;
+
+  MatrixViewRow(T *, ptrdiff_t);
+  T &operator[](size_t) const;
+  T *data() const;
+
+ private:
+  T *data_;
+  ptrdiff_t stride_;
+};
+
+template <typename T>
+MatrixViewRow<T>::MatrixViewRow(T *data, ptrdiff_t stride)
+    : data_(data), stride_(stride) {
+}
+
+template <typename T> T &
+MatrixViewRow<T>::operator[](size_t col) const {
+  return this->data_[static_cast<ptrdiff_t>(col) * this->stride_];
+}
+
+template <typename T> T *
+MatrixViewRow<T>::data() const {
+  return this->data_;
+}
+
+// A window on the elements of a matrix (fix-sized or not), made by
+// block(r, c, h, w), row(i), col(j) and transposed() of matrices and views.
+// It is only a pointer and two strides: copying a view never copies the
+// elements, while assigning to a view writes through it.
+// Since C++11 views take part in the expressions of MatrixExpression.hh,
+// e.g. A.block(0, 0, 4, 4) += B.col(j) * C.row(i);
+// The elimination members work in place on the elements under the view.
+// A view dangles once its matrix is resized, moved or destroyed.
+template <typename T>
+class MatrixView {
+ public:
+  MatrixView(T *, size_t, size_t, ptrdiff_t, ptrdiff_t);
+  MatrixView(const MatrixView &);
+  // MatrixView<T> converts to MatrixView<const T>.
+  template <typename U>
+  MatrixView(const MatrixView<U> &);
+
+  MatrixView &operator=(const MatrixView &);
+  template <typename Source>
+  MatrixView &copyFrom(const Source &);
+#if __cplusplus >= 201103L
+  template <typename Rhs, typename = typename MatrixExpressionOf<Rhs>::type>
+  MatrixView &operator=(const Rhs &);
+  template <typename Rhs, typename = typename MatrixExpressionOf<Rhs>::type>
+  MatrixView &operator+=(const Rhs &);
+  template <typename Rhs, typename = typename MatrixExpressionOf<Rhs>::type>
+  MatrixView &operator-=(const Rhs &);
+#endif  // __cplusplus >= 201103L
+
+  MatrixViewRow<T> operator[](size_t) const;
+  T &operator()(size_t, size_t) const;
+  size_t row() const;
+  size_t col() const;
+  ptrdiff_t rowStride() const;
+  ptrdiff_t colStride() const;
+  T *data() const;
+
+  MatrixView block(size_t, size_t, size_t, size_t) const;
+  MatrixView row(size_t) const;
+  MatrixView col(size_t) const;
+  MatrixView transposed() const;
+
+  MatrixView &triangularize();
+  MatrixView &eliminate();
+  MatrixView &inverse();
+  typename MatrixViewValue_<T>::type determinant() const;
+
+ private:
+  T *data_;
+  size_t row_, col_;
+  ptrdiff_t rowStride_, colStride_;
+
+  void rowsOf_(std::vector<MatrixViewRow<T> > &) const;
+  void restoreRows_(MatrixViewRow<T> *) const;
+};
+
+template <typename T>
+MatrixView<T>::MatrixView(T *data, size_t row, size_t col,
+                          ptrdiff_t rowStride, ptrdiff_t colStride)
+    : data_(data), row_(row), col_(col),
+      rowStride_(rowStride), colStride_(colStride) {
+}
+
+// Copies the view, not the elements.
+template <typename T>
+MatrixView<T>::MatrixView(const MatrixView &that)
+    : data_(that.data_), row_(that.row_), col_(that.col_),
+      rowStride_(that.rowStride_), colStride_(that.colStride_) {
+}
+
+template <typename T> template <typename U>
+MatrixView<T>::MatrixView(const MatrixView<U> &that)
+    : data_(that.data()), row_(that.row()), col_(that.col()),
+      rowStride_(that.rowStride()), colStride_(that.colStride()) {
+}
+
+// Copies the elements, not the view.
+template <typename T> MatrixView<T> &
+MatrixView<T>::operator=(const MatrixView &that) {
+  return this->copyFrom(that);
+}
+
+// Copies the elements of a matrix or a view of the same size.
+// Throws std::invalid_argument if the size does not match.
+template <typename T> template <typename Source> MatrixView<T> &
+MatrixView<T>::copyFrom(const Source &that) {
+  typedef typename MatrixViewValue_<T>::type Value;
+  const size_t row = this->row_, col = this->col_;
+  if (row != that.row() || col != that.col())
+    throw std::invalid_argument("MatrixView::copyFrom");
+  const MatrixSpan span = spanOf_(*this), from = spanOf_(that);
+  if (span.overlaps(from) && !span.sameAs(from)) {
+    // Shifted windows on the same matrix, go through a copy.
+    std::vector<Value> copy;
+    copy.reserve(row * col);
+    for (size_t r = 0; r != row; ++r)
+      for (size_t c = 0; c != col; ++c) copy.push_back(that[r][c]);
+    for (size_t r = 0; r != row; ++r)
+      for (size_t c = 0; c != col; ++c) (*this)(r, c) = copy[r * col + c];
+  } else {
+    for (size_t r = 0; r != row; ++r)
+      for (size_t c = 0; c != col; ++c) (*this)(r, c) = that[r][c];
+  }
+  return *this;
+}
+
+template <typename T> MatrixViewRow<T>
+MatrixView<T>::operator[](size_t row) const {
+  return MatrixViewRow<T>(this->data_ + static_cast<ptrdiff_t>(row)
+                                        * this->rowStride_, this->colStride_);
+}
+
+template <typename T> T &
+MatrixView<T>::operator()(size_t row, size_t col) const {
+  return this->data_[static_cast<ptrdiff_t>(row) * this->rowStride_
+                     + static_cast<ptrdiff_t>(col) * this->colStride_];
+}
+
+template <typename T> size_t
+MatrixView<T>::row() const {
+  return this->row_;
+}
+
+template <typename T> size_t
+MatrixView<T>::col() const {
+  return this->col_;
+}
+
+template <typename T> ptrdiff_t
+MatrixView<T>::rowStride() const {
+  return this->rowStride_;
+}
+
+template <typename T> ptrdiff_t
+MatrixView<T>::colStride() const {
+  return this->colStride_;
+}
+
+template <typename T> T *
+MatrixView<T>::data() const {
+  return this->data_;
+}
+
+// Throws std::invalid_argument if the block is not inside the view.
+template <typename T> MatrixView<T>
+MatrixView<T>::block(size_t r, size_t c, size_t h, size_t w) const {
+  if (r > this->row_ || h > this->row_ - r
+      || c > this->col_ || w > this->col_ - c)
+    throw std::invalid_argument("MatrixView::block");
+  return MatrixView(h && w ? &(*this)(r, c) : this->data_, h, w,
+                    this->rowStride_, this->colStride_);
+}
+
+template <typename T> MatrixView<T>
+MatrixView<T>::row(size_t r) const {
+  return this->block(r, 0, 1, this->col_);
+}
+
+template <typename T> MatrixView<T>
+MatrixView<T>::col(size_t c) const {
+  return this->block(0, c, this->row_, 1);
+}
+
+template <typename T> MatrixView<T>
+MatrixView<T>::transposed() const {
+  return MatrixView(this->data_, this->col_, this->row_,
+                    this->colStride_, this->rowStride_);
+}
+
+template <typename T> void
+MatrixView<T>::rowsOf_(std::vector<MatrixViewRow<T> > &matrix) const {
+  matrix.reserve(this->row_);
+  for (size_t r = 0; r != this->row_; ++r) matrix.push_back((*this)[r]);
+}
+
+// The same as permuteRows_, for rows of a view.
+template <typename T> void
+MatrixView<T>::restoreRows_(MatrixViewRow<T> *matrix) const {
+  using std::swap;
+  for (size_t i = 0; i != this->row_; ++i)
+    for (size_t j = i; matrix[j].data() != (*this)[j].data(); ) {
+      const size_t k = (matrix[j].data() - this->data_) / this->rowStride_;
+      matrix[j] = (*this)[j];
+      if (k == i) break;
+      for (size_t c = 0; c != this->col_; ++c)
+        swap((*this)(j, c), (*this)(k, c));
+      j = k;
+    }
+}
+
+template <typename T> MatrixView<T> &
+MatrixView<T>::triangularize() {
+  std::vector<MatrixViewRow<T> > matrix;
+  this->rowsOf_(matrix);
+  if (matrix.empty()) return *this;
+  triangularize_(&matrix[0], this->row_, this->col_);
+  this->restoreRows_(&matrix[0]);
+  return *this;
+}
+
+template <typename T> MatrixView<T> &
+MatrixView<T>::eliminate() {
+  std::vector<MatrixViewRow<T> > matrix;
+  this->rowsOf_(matrix);
+  if (matrix.empty()) return *this;
+  triangularize_(&matrix[0], this->row_, this->col_);
+  canonicalize_(&matrix[0], this->row_, this->col_);
+  this->restoreRows_(&matrix[0]);
+  return *this;
+}
+
+// Throws std::invalid_argument if not square or not inversible, and the
+// elements are unspecified in the latter case.
+template <typename T> MatrixView<T> &
+MatrixView<T>::inverse() {
+  if (this->row_ != this->col_)
+    throw std::invalid_argument("MatrixView::inverse");
+  std::vector<MatrixViewRow<T> > matrix;
+  std::vector<size_t> pivot(this->row_);
+  this->rowsOf_(matrix);
+  if (matrix.empty()) return *this;
+  if (!inverse_(&matrix[0], this->row_, &pivot[0]))
+    throw std::invalid_argument("MatrixView::inverse");
+  this->restoreRows_(&matrix[0]);
+  return *this;
+}
+
+template <typename T> typename MatrixViewValue_<T>::type
+MatrixView<T>::determinant() const {
+  typedef typename MatrixViewValue_<T>::type Value;
+  const size_t len = this->row_;
+  if (len != this->col_)
+    throw std::invalid_argument("MatrixView::determinant");
+  if (!len) return 1;
+  std::vector<Value> copy;
+  std::vector<Value *> matrix(len);
+  copy.reserve(len * len);
+  for (size_t r = 0; r != len; ++r)
+    for (size_t c = 0; c != len; ++c) copy.push_back((*this)(r, c));
+  for (size_t r = 0; r != len; ++r) matrix[r] = &copy[r * len];
+  Value result = triangularize_(&matrix[0], len, len) ? 1 : -1;
+  for (size_t i = 0; i != len && !(result == Value(0)); ++i)
+    result *= matrix[i][i];
+  return result;
+}
+
+#if __cplusplus >= 201103L
+template <typename T>
+class MatrixViewLeaf {
+ public:
+  typedef void IsMatrixExpression;
+  typedef typename MatrixViewValue_<T>::type Value;
+  typedef Matrix<Value> Result;
+  typedef MatrixView<const Value> Operand;
+  static const size_t fixedRow = 0, fixedCol = 0;
+  static const bool coefficientWise = true;
+
+  explicit MatrixViewLeaf(const Operand &view) : view_(view) {}
+
+  size_t row() const { return view_.row(); }
+  size_t col() const { return view_.col(); }
+  const Value &at(size_t r, size_t c) const { return view_(r, c); }
+  bool aliases(const MatrixSpan &span) const {
+    return spanOf_(view_).overlaps(span);
+  }
+  bool clobbers(const MatrixSpan &span) const {
+    return this->aliases(span) && !spanOf_(view_).sameAs(span);
+  }
+  Operand operand() const { return view_; }
+
+  template <bool Negate, typename Dest> void assignTo(Dest &dest) const {
+    assignCoefficients_<Negate>(dest, *this);
+  }
+  template <bool Subtract, typename Dest> void updateTo(Dest &dest) const {
+    updateCoefficients_<Subtract>(dest, *this);
+  }
+
+ private:
+  Operand view_;
+};
+
+template <typename T>
+struct MatrixExpressionOf<MatrixView<T>, void> {
+  typedef MatrixViewLeaf<T> type;
+  static type wrap(const MatrixView<T> &view) { return type(view); }
+};
+
+// Throws std::invalid_argument if the size does not match.
+template <typename T> template <typename Rhs, typename>
+MatrixView<T> &MatrixView<T>::operator=(const Rhs &rhs) {
+  const auto &expr = MatrixExpressionOf<Rhs>::wrap(rhs);
+  if (this->row_ != expr.row() || this->col_ != expr.col())
+    throw std::invalid_argument("MatrixView::operator=");
+  if (expr.clobbers(spanOf_(*this))) {
+    const typename std::decay<decltype(expr)>::type::Result result(expr);
+    return this->copyFrom(result);
+  }
+  expr.template assignTo<false>(*this);
+  return *this;
+}
+
+template <typename T> template <typename Rhs, typename>
+MatrixView<T> &MatrixView<T>::operator+=(const Rhs &rhs) {
+  return updateMatrix_<false>(*this, MatrixExpressionOf<Rhs>::wrap(rhs),
+                              "MatrixView::operator+=");
+}
+
+template <typename T> template <typename Rhs, typename>
+MatrixView<T> &MatrixView<T>::operator-=(const Rhs &rhs) {
+  return updateMatrix_<true>(*this, MatrixExpressionOf<Rhs>::wrap(rhs),
+                             "MatrixView::operator-=");
+}
+#endif  // __cplusplus >= 201103L
@@ -0,0 +1,250 @@
+#pragma once
+
+#include <limits>
+#include <stdexcept>
+// cstdint is a C++11 header.
+#include <stdint.h>
+#include <vector>
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE4_1__)
+#include <smmintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "Matrix.hh"
+#include "VariableMatrix.hh"
+
+// Matrix products over other semirings than (+, *), e.g. (min, +) for
+// shortest paths and (or, and) for reachability:
+//   Matrix<int> d = power<MinPlus<int> >(graph, n);
+// A semiring policy has Value, zero() (the identity of add, absorbing for
+// multiply), one() and add, multiply. The row updates of the min-plus
+// product run with SSE or AVX for int and float, and the boolean product
+// is on bitsets; any other semiring and T take the scalar path.
+
+template <typename T>
+struct PlusTimes {
+  typedef T Value;
+  static T zero() { return T(0); }
+  static T one() { return T(1); }
+  static T add(const T &a, const T &b) { return a + b; }
+  static T multiply(const T &a, const T &b) { return a * b; }
+};
+
+// Infinity of T, or the largest value if it has none.
+template <typename T> T
+semiringInfinity_() {
+  return std::numeric_limits<T>::has_infinity
+      ? std::numeric_limits<T>::infinity() : std::numeric_limits<T>::max();
+}
+
+// Unreachable is zero(), and never takes part in a sum, so that it does
+// not overflow for integers.
+template <typename T>
+struct MinPlus {
+  typedef T Value;
+  static T zero() { return semiringInfinity_<T>(); }
+  static T one() { return T(0); }
+  static T add(const T &a, const T &b) { return b < a ? b : a; }
+  static T multiply(const T &a, const T &b) {
+    return a == zero() || b == zero() ? zero() : a + b;
+  }
+};
+
+template <typename T>
+struct MaxPlus {
+  typedef T Value;
+  static T zero() {
+    return std::numeric_limits<T>::has_infinity
+        ? -std::numeric_limits<T>::infinity() : std::numeric_limits<T>::min();
+  }
+  static T one() { return T(0); }
+  static T add(const T &a, const T &b) { return a < b ? b : a; }
+  static T multiply(const T &a, const T &b) {
+    return a == zero() || b == zero() ? zero() : a + b;
+  }
+};
+
+struct BooleanSemiring {
+  typedef bool Value;
+  static bool zero() { return false; }
+  static bool one() { return true; }
+  static bool add(bool a, bool b) { return a || b; }
+  static bool multiply(bool a, bool b) { return a && b; }
+};
+
+// dst[c] = add(dst[c], multiply(f, src[c])) for c < n.
+template <typename Semiring>
+struct SemiringKernel_ {
+  typedef typename Semiring::Value T;
+  static void run(T *dst, const T &f, const T *src, size_t n) {
+    for (size_t c = 0; c != n; ++c)
+      dst[c] = Semiring::add(dst[c], Semiring::multiply(f, src[c]));
+  }
+};
+
+// a + inf is inf for float, so it is just min(dst, f + src).
+#if defined(__AVX__)
+template <>
+struct SemiringKernel_<MinPlus<float> > {
+  static void run(float *dst, const float &f, const float *src, size_t n) {
+    const __m256 g = _mm256_set1_ps(f);
+    size_t c = 0;
+    for (; c + 8 <= n; c += 8)
+      _mm256_storeu_ps(dst + c, _mm256_min_ps(_mm256_loadu_ps(dst + c),
+          _mm256_add_ps(g, _mm256_loadu_ps(src + c))));
+    for (; c != n; ++c) dst[c] = std::min(dst[c], f + src[c]);
+  }
+};
+#elif defined(__SSE2__)
+template <>
+struct SemiringKernel_<MinPlus<float> > {
+  static void run(float *dst, const float &f, const float *src, size_t n) {
+    const __m128 g = _mm_set1_ps(f);
+    size_t c = 0;
+    for (; c + 4 <= n; c += 4)
+      _mm_storeu_ps(dst + c, _mm_min_ps(
+          _mm_loadu_ps(dst + c), _mm_add_ps(g, _mm_loadu_ps(src + c))));
+    for (; c != n; ++c) dst[c] = std::min(dst[c], f + src[c]);
+  }
+};
+#endif
+
+// For int, f is never the infinity (see SemiringProduct_), and the sums
+// with an infinite src[c] are masked back to the infinity.
+#if defined(__AVX2__)
+template <>
+struct SemiringKernel_<MinPlus<int> > {
+  static void run(int *dst, const int &f, const int *src, size_t n) {
+    const int infinity = MinPlus<int>::zero();
+    const __m256i g = _mm256_set1_epi32(f), h = _mm256_set1_epi32(infinity);
+    size_t c = 0;
+    for (; c + 8 <= n; c += 8) {
+      const __m256i b = _mm256_loadu_si256(
+          reinterpret_cast<const __m256i *>(src + c));
+      const __m256i s = _mm256_blendv_epi8(_mm256_add_epi32(g, b), h,
+                                           _mm256_cmpeq_epi32(b, h));
+      __m256i *const d = reinterpret_cast<__m256i *>(dst + c);
+      _mm256_storeu_si256(d, _mm256_min_epi32(_mm256_loadu_si256(d), s));
+    }
+    for (; c != n; ++c)
+      if (src[c] != infinity) dst[c] = std::min(dst[c], f + src[c]);
+  }
+};
+#elif defined(__SSE4_1__)
+template <>
+struct SemiringKernel_<MinPlus<int> > {
+  static void run(int *dst, const int &f, const int *src, size_t n) {
+    const int infinity = MinPlus<int>::zero();
+    const __m128i g = _mm_set1_epi32(f), h = _mm_set1_epi32(infinity);
+    size_t c = 0;
+    for (; c + 4 <= n; c += 4) {
+      const __m128i b = _mm_loadu_si128(
+          reinterpret_cast<const __m128i *>(src + c));
+      const __m128i s = _mm_blendv_epi8(_mm_add_epi32(g, b), h,
+                                        _mm_cmpeq_epi32(b, h));
+      __m128i *const d = reinterpret_cast<__m128i *>(dst + c);
+      _mm_storeu_si128(d, _mm_min_epi32(_mm_loadu_si128(d), s));
+    }
+    for (; c != n; ++c)
+      if (src[c] != infinity) dst[c] = std::min(dst[c], f + src[c]);
+  }
+};
+#endif
+
+// dest = lhs * rhs over Semiring, row by row (i-k-j), skipping the zero()
+// elements of lhs. dest must not alias lhs or rhs.
+template <typename Semiring>
+struct SemiringProduct_ {
+  template <typename Dest, typename Lhs, typename Rhs>
+  static void run(Dest &dest, const Lhs &lhs, const Rhs &rhs,
+                  size_t row, size_t mid, size_t col) {
+    typedef typename Semiring::Value T;
+    const T zero = Semiring::zero();
+    for (size_t r = 0; r != row; ++r) {
+      T *const d = dest[r];
+      for (size_t c = 0; c != col; ++c) d[c] = zero;
+      for (size_t k = 0; k != mid; ++k)
+        if (!(lhs[r][k] == zero))
+          SemiringKernel_<Semiring>::run(d, lhs[r][k], rhs[k], col);
+    }
+  }
+};
+
+// Row k of rhs as a bitset of 64-bit words, then row r of the product is
+// the union of those where lhs[r][k] is set.
+template <>
+struct SemiringProduct_<BooleanSemiring> {
+  template <typename Dest, typename Lhs, typename Rhs>
+  static void run(Dest &dest, const Lhs &lhs, const Rhs &rhs,
+                  size_t row, size_t mid, size_t col) {
+    const size_t words = (col + 63) / 64;
+    std::vector<uint64_t> bits(mid * words + 1, 0), sum(words + 1);
+    for (size_t k = 0; k != mid; ++k)
+      for (size_t c = 0; c != col; ++c)
+        if (rhs[k][c]) bits[k * words + c / 64] |= uint64_t(1) << c % 64;
+    for (size_t r = 0; r != row; ++r) {
+      std::fill(sum.begin(), sum.end(), 0);
+      for (size_t k = 0; k != mid; ++k) {
+        if (!lhs[r][k]) continue;
+        const uint64_t *const b = &bits[k * words];
+        for (size_t w = 0; w != words; ++w) sum[w] |= b[w];
+      }
+      for (size_t c = 0; c != col; ++c)
+        dest[r][c] = (sum[c / 64] >> c % 64 & 1) != 0;
+    }
+  }
+};
+
+// T is Semiring::Value, deduced only to tell the overloads apart.
+template <typename Semiring, typename T, size_t Row, size_t Mid, size_t Col>
+Matrix<T, Row, Col>
+multiply(const Matrix<T, Row, Mid> &lhs, const Matrix<T, Mid, Col> &rhs) {
+  Matrix<T, Row, Col> result;
+  SemiringProduct_<Semiring>::run(result, lhs, rhs, Row, Mid, Col);
+  return result;
+}
+
+// Throws std::invalid_argument if the sizes do not match.
+template <typename Semiring, typename T> Matrix<T>
+multiply(const Matrix<T> &lhs, const Matrix<T> &rhs) {
+  if (lhs.col() != rhs.row())
+    throw std::invalid_argument("multiply");
+  Matrix<T> result(lhs.row(), rhs.col(), lhs.storage());
+  SemiringProduct_<Semiring>::run(result, lhs, rhs,
+                                  lhs.row(), lhs.col(), rhs.col());
+  return result;
+}
+
+// matrix^exponent by squaring, with one() on the diagonal for 0.
+template <typename Semiring, typename T, size_t Len> Matrix<T, Len, Len>
+power(const Matrix<T, Len, Len> &matrix, unsigned long long exponent) {
+  Matrix<T, Len, Len> result, base = matrix;
+  for (size_t r = 0; r != Len; ++r)
+    for (size_t c = 0; c != Len; ++c)
+      result[r][c] = r == c ? Semiring::one() : Semiring::zero();
+  for (; exponent; exponent >>= 1) {
+    if (exponent & 1) result = multiply<Semiring>(result, base);
+    if (exponent > 1) base = multiply<Semiring>(base, base);
+  }
+  return result;
+}
+
+// Throws std::invalid_argument if not square.
+template <typename Semiring, typename T> Matrix<T>
+power(const Matrix<T> &matrix, unsigned long long exponent) {
+  const size_t len = matrix.row();
+  if (len != matrix.col())
+    throw std::invalid_argument("power");
+  Matrix<T> result(len, len, matrix.storage()), base = matrix;
+  for (size_t r = 0; r != len; ++r)
+    for (size_t c = 0; c != len; ++c)
+      result[r][c] = r == c ? Semiring::one() : Semiring::zero();
+  for (; exponent; exponent >>= 1) {
+    if (exponent & 1) result = multiply<Semiring>(result, base);
+    if (exponent > 1) base = multiply<Semiring>(base, base);
+  }
+  return result;
+}
@@ -0,0 +1,456 @@
+#pragma once
+
+#include <algorithm>
+#include <functional>  // std::greater
+#include <queue>
+#include <stdexcept>
+#include <utility>  // std::pair
+#include <vector>
+#ifdef _OPENMP
+#include <omp.h>
+#endif  // _OPENMP
+
+#include "MatrixDecl.hh"
+#include "VariableMatrix.hh"
+
+// An element of a SparseMatrix to build, in any order.
+template <typename T>
+struct SparseTriplet {
+  size_t row, col;
+  T value;
+};
+
+template <typename T>
+SparseTriplet<T> makeSparseTriplet(size_t row, size_t col, const T &value) {
+  SparseTriplet<T> triplet = { row, col, value };
+  return triplet;
+}
+
+// Compressed sparse row matrix, for the 10^6 x 10^6 systems with a few
+// nonzeros a row where Matrix<T> would take terabytes.
+// Row r has the nonzeros values()[i] at columns colIndex()[i] for i from
+// rowBegin()[r] to rowBegin()[r + 1], sorted by column.
+// The compressed sparse column form of A is the CSR form of A^T, which
+// transposed() builds in O(nnz).
+// The products run in parallel over the rows if compiled with OpenMP.
+// Elimination (rank, determinant, solve) is meant for exact types, e.g.
+// Residue or Rational, since its pivots are chosen for sparsity only.
+template <typename T>
+class SparseMatrix {
+ public:
+  SparseMatrix();
+  SparseMatrix(size_t, size_t);
+  // Duplicated triplets are added up, and exact zeros are dropped.
+  // Throws std::invalid_argument if a triplet is out of range.
+  template <typename InputIter>
+  SparseMatrix(size_t, size_t, InputIter, InputIter);
+
+  size_t row() const;
+  size_t col() const;
+  size_t nonZeros() const;
+  const size_t *rowBegin() const;
+  const size_t *colIndex() const;
+  const T *values() const;
+  // Zero if not stored, by binary search in the row.
+  T at(size_t, size_t) const;
+
+  SparseMatrix transposed() const;
+  Matrix<T> toDense() const;
+
+  // y = A * x, or y = A^T * x. x has col() (row()) elements and y has
+  // row() (col()) ones, and they must not overlap.
+  void multiply(const T *, T *) const;
+  void multiplyTransposed(const T *, T *) const;
+
+  // Structured Gaussian elimination, see eliminate_ below.
+  size_t rank() const;
+  // Throws std::invalid_argument if not square.
+  T determinant() const;
+  // Finds some x with A * x = b, where b has row() elements and x has col()
+  // ones; the free variables are zero. Returns false if there is none.
+  bool solve(const T *, T *) const;
+
+ private:
+  size_t row_, col_;
+  std::vector<size_t> rowBegin_, colIndex_;
+  std::vector<T> values_;
+
+  typedef std::vector<std::pair<size_t, T> > Row_;
+  // T may have no operator<, e.g. Residue.
+  struct LessColumn_ {
+    bool operator()(const std::pair<size_t, T> &lhs,
+                    const std::pair<size_t, T> &rhs) const {
+      return lhs.first < rhs.first;
+    }
+  };
+  // The pivots found by eliminate_, in order.
+  struct Pivot_ {
+    size_t row, col;
+    T value;
+  };
+
+  size_t eliminate_(std::vector<Row_> &, std::vector<Pivot_> &, T *) const;
+};
+
+template <typename T>
+SparseMatrix<T>::SparseMatrix()
+    : row_(0), col_(0), rowBegin_(1, 0) {
+}
+
+template <typename T>
+SparseMatrix<T>::SparseMatrix(size_t row, size_t col)
+    : row_(row), col_(col), rowBegin_(row + 1, 0) {
+}
+
+// Counting sort by row, then sort every row by column.
+template <typename T> template <typename InputIter>
+SparseMatrix<T>::SparseMatrix(size_t row, size_t col,
+                              InputIter begin, InputIter end)
+    : row_(row), col_(col), rowBegin_(row + 1, 0) {
+  std::vector<size_t> count(row + 1, 0);
+  size_t size = 0;
+  for (InputIter it = begin; it != end; ++it, ++size) {
+    if (it->row >= row || it->col >= col)
+      throw std::invalid_argument("SparseMatrix::SparseMatrix");
+    ++count[it->row + 1];
+  }
+  for (size_t r = 0; r != row; ++r) count[r + 1] += count[r];
+  std::vector<std::pair<size_t, T> > entries(size);
+  for (InputIter it = begin; it != end; ++it)
+    entries[count[it->row]++] = std::make_pair(it->col, it->value);
+  // count[r] is the end of row r now.
+  this->colIndex_.reserve(size);
+  this->values_.reserve(size);
+  for (size_t r = 0, first = 0; r != row; first = count[r++]) {
+    std::sort(entries.begin() + first, entries.begin() + count[r],
+              LessColumn_());
+    for (size_t i = first; i != count[r]; ) {
+      const size_t c = entries[i].first;
+      T value = entries[i].second;
+      while (++i != count[r] && entries[i].first == c)
+        value += entries[i].second;
+      if (value == T()) continue;
+      this->colIndex_.push_back(c);
+      this->values_.push_back(value);
+    }
+    this->rowBegin_[r + 1] = this->colIndex_.size();
+  }
+}
+
+template <typename T> size_t
+SparseMatrix<T>::row() const {
+  return this->row_;
+}
+
+template <typename T> size_t
+SparseMatrix<T>::col() const {
+  return this->col_;
+}
+
+template <typename T> size_t
+SparseMatrix<T>::nonZeros() const {
+  return this->values_.size();
+}
+
+template <typename T> const size_t *
+SparseMatrix<T>::rowBegin() const {
+  return &this->rowBegin_[0];
+}
+
+template <typename T> const size_t *
+SparseMatrix<T>::colIndex() const {
+  return this->colIndex_.empty() ? NULL : &this->colIndex_[0];
+}
+
+template <typename T> const T *
+SparseMatrix<T>::values() const {
+  return this->values_.empty() ? NULL : &this->values_[0];
+}
+
+template <typename T> T
+SparseMatrix<T>::at(size_t row, size_t col) const {
+  const size_t *const begin = this->colIndex() + this->rowBegin_[row];
+  const size_t *const end = this->colIndex() + this->rowBegin_[row + 1];
+  const size_t *const it = std::lower_bound(begin, end, col);
+  return it != end && *it == col ? this->values_[it - this->colIndex()]
+                                 : T(0);
+}
+
+// Counting sort by column, which keeps every new row sorted.
+template <typename T> SparseMatrix<T>
+SparseMatrix<T>::transposed() const {
+  SparseMatrix result(this->col_, this->row_);
+  const size_t size = this->nonZeros();
+  std::vector<size_t> &begin = result.rowBegin_;
+  for (size_t i = 0; i != size; ++i) ++begin[this->colIndex_[i] + 1];
+  for (size_t c = 0; c != this->col_; ++c) begin[c + 1] += begin[c];
+  result.colIndex_.resize(size);
+  result.values_.resize(size);
+  std::vector<size_t> next(begin.begin(), begin.end() - 1);
+  for (size_t r = 0; r != this->row_; ++r)
+    for (size_t i = this->rowBegin_[r]; i != this->rowBegin_[r + 1]; ++i) {
+      const size_t j = next[this->colIndex_[i]]++;
+      result.colIndex_[j] = r;
+      result.values_[j] = this->values_[i];
+    }
+  return result;
+}
+
+template <typename T> Matrix<T>
+SparseMatrix<T>::toDense() const {
+  Matrix<T> result(this->row_, this->col_);
+  for (size_t r = 0; r != this->row_; ++r) {
+    std::fill(result[r], result[r] + this->col_, T(0));
+    for (size_t i = this->rowBegin_[r]; i != this->rowBegin_[r + 1]; ++i)
+      result[r][this->colIndex_[i]] = this->values_[i];
+  }
+  return result;
+}
+
+// Rows are independent, so they are split among the threads.
+// ptrdiff_t since OpenMP 2 wants a signed loop variable.
+template <typename T> void
+SparseMatrix<T>::multiply(const T *x, T *y) const {
+  const ptrdiff_t row = this->row_;
+  const size_t *const begin = this->rowBegin(), *const index = this->colIndex();
+  const T *const value = this->values();
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static)
+#endif  // _OPENMP
+  for (ptrdiff_t r = 0; r < row; ++r) {
+    T sum = T(0);
+    for (size_t i = begin[r]; i != begin[r + 1]; ++i)
+      sum += value[i] * x[index[i]];
+    y[r] = sum;
+  }
+}
+
+// Scatters row by row. With OpenMP every thread scatters a range of rows
+// into a y of its own, and those are added up column by column at last.
+// The threads are at most nnz / col, so that the copies of y take no more
+// memory than the matrix itself.
+template <typename T> void
+SparseMatrix<T>::multiplyTransposed(const T *x, T *y) const {
+  const size_t row = this->row_, col = this->col_;
+  const size_t *const begin = this->rowBegin(), *const index = this->colIndex();
+  const T *const value = this->values();
+#ifdef _OPENMP
+  const size_t threads = std::min<size_t>(omp_get_max_threads(),
+                                          col ? this->nonZeros() / col : 0);
+  if (threads > 1 && !omp_in_parallel()) {
+    std::vector<T> partial(threads * col, T(0));
+    const ptrdiff_t columns = col;
+#pragma omp parallel num_threads(threads)
+    {
+      const size_t t = omp_get_thread_num(), n = omp_get_num_threads();
+      T *const z = &partial[t * col];
+      for (size_t r = row * t / n; r != row * (t + 1) / n; ++r)
+        for (size_t i = begin[r]; i != begin[r + 1]; ++i)
+          z[index[i]] += value[i] * x[r];
+#pragma omp barrier
+#pragma omp for schedule(static)
+      for (ptrdiff_t c = 0; c < columns; ++c) {
+        T sum = partial[c];
+        for (size_t k = 1; k != n; ++k) sum += partial[k * col + c];
+        y[c] = sum;
+      }
+    }
+    return;
+  }
+#endif  // _OPENMP
+  std::fill(y, y + col, T(0));
+  for (size_t r = 0; r != row; ++r)
+    for (size_t i = begin[r]; i != begin[r + 1]; ++i)
+      y[index[i]] += value[i] * x[r];
+}
+
+template <typename T> std::vector<T>
+operator*(const SparseMatrix<T> &lhs, const std::vector<T> &rhs) {
+  if (lhs.col() != rhs.size())
+    throw std::invalid_argument("SparseMatrix::operator*");
+  std::vector<T> result(lhs.row());
+  if (lhs.row()) lhs.multiply(rhs.empty() ? NULL : &rhs[0], &result[0]);
+  return result;
+}
+
+// Sparse times dense, streaming the rows of rhs picked by every row of lhs.
+template <typename T> Matrix<T>
+operator*(const SparseMatrix<T> &lhs, const Matrix<T> &rhs) {
+  if (lhs.col() != rhs.row())
+    throw std::invalid_argument("SparseMatrix::operator*");
+  const ptrdiff_t row = lhs.row();
+  const size_t col = rhs.col();
+  const size_t *const begin = lhs.rowBegin(), *const index = lhs.colIndex();
+  const T *const value = lhs.values();
+  Matrix<T> result(row, col, rhs.storage());
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic, 64)
+#endif  // _OPENMP
+  for (ptrdiff_t r = 0; r < row; ++r) {
+    T *const d = result[r];
+    std::fill(d, d + col, T(0));
+    for (size_t i = begin[r]; i != begin[r + 1]; ++i) {
+      const T f = value[i];
+      const T *const s = rhs[index[i]];
+      for (size_t c = 0; c != col; ++c) d[c] += f * s[c];
+    }
+  }
+  return result;
+}
+
+// Structured Gaussian elimination with the Markowitz heuristic: every step
+// pivots on the column with the fewest nonzeros left, and in it on the
+// shortest row, which keeps the fill-in low. rows are the rows of the
+// matrix as (column, value) sorted by column; b, if any, goes through the
+// same row operations. Each pivot row is left as it was when it pivoted.
+// Returns the rank.
+template <typename T> size_t
+SparseMatrix<T>::eliminate_(std::vector<Row_> &rows,
+                            std::vector<Pivot_> &pivots, T *b) const {
+  typedef std::pair<size_t, size_t> Entry;  // (count, column)
+  const size_t none = ~static_cast<size_t>(0);
+  rows.assign(this->row_, Row_());
+  // Rows holding each column, may be stale after eliminations.
+  std::vector<std::vector<size_t> > holders(this->col_);
+  std::vector<size_t> count(this->col_, 0);
+  std::vector<bool> rowDone(this->row_, false), colDone(this->col_, false);
+  // mark[r] == c once row r is found live for column c.
+  std::vector<size_t> mark(this->row_, none);
+  for (size_t r = 0; r != this->row_; ++r)
+    for (size_t i = this->rowBegin_[r]; i != this->rowBegin_[r + 1]; ++i) {
+      const size_t c = this->colIndex_[i];
+      rows[r].push_back(std::make_pair(c, this->values_[i]));
+      holders[c].push_back(r);
+      ++count[c];
+    }
+  // Lazy min-heap: an entry is stale once its count is outdated.
+  std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry> > heap;
+  for (size_t c = 0; c != this->col_; ++c)
+    if (count[c]) heap.push(Entry(count[c], c));
+  pivots.clear();
+  Row_ merged;
+  while (!heap.empty()) {
+    const Entry top = heap.top();
+    heap.pop();
+    const size_t c = top.second;
+    if (colDone[c] || top.first != count[c] || !count[c]) continue;
+    // The shortest live row holding c, dropping the stale holders.
+    std::vector<size_t> live;
+    size_t p = none;
+    for (size_t k = 0; k != holders[c].size(); ++k) {
+      const size_t r = holders[c][k];
+      if (rowDone[r]) continue;
+      const typename Row_::iterator it = std::lower_bound(
+          rows[r].begin(), rows[r].end(), std::make_pair(c, T(0)),
+          LessColumn_());
+      if (it == rows[r].end() || it->first != c || mark[r] == c) continue;
+      mark[r] = c;
+      live.push_back(r);
+      if (p == none || rows[r].size() < rows[p].size()) p = r;
+    }
+    holders[c].swap(live);
+    if (p == none) continue;
+    const Row_ &pivot = rows[p];
+    const T value = std::lower_bound(pivot.begin(), pivot.end(),
+                                     std::make_pair(c, T(0)),
+                                     LessColumn_())->second;
+    Pivot_ record = { p, c, value };
+    pivots.push_back(record);
+    rowDone[p] = colDone[c] = true;
+    for (size_t k = 0; k != pivot.size(); ++k) {
+      const size_t col = pivot[k].first;
+      if (--count[col] && !colDone[col]) heap.push(Entry(count[col], col));
+    }
+    for (size_t k = 0; k != holders[c].size(); ++k) {
+      const size_t r = holders[c][k];
+      if (r == p) continue;
+      Row_ &target = rows[r];
+      // target -= f * pivot, merging the two sorted rows.
+      const T f = std::lower_bound(target.begin(), target.end(),
+                                   std::make_pair(c, T(0)),
+                                   LessColumn_())->second / value;
+      if (b) b[r] -= f * b[p];
+      merged.clear();
+      size_t i = 0, j = 0;
+      while (i != target.size() || j != pivot.size()) {
+        if (j == pivot.size()
+            || (i != target.size() && target[i].first < pivot[j].first)) {
+          merged.push_back(target[i++]);
+          continue;
+        }
+        const size_t col = pivot[j].first;
+        const bool both = i != target.size() && target[i].first == col;
+        const T updated = (both ? target[i].second : T(0))
+                          - f * pivot[j].second;
+        if (both) ++i; else holders[col].push_back(r);
+        ++j;
+        if (col != c && !isZero(updated)) {
+          merged.push_back(std::make_pair(col, updated));
+          if (both) continue;
+          ++count[col];  // Fill-in.
+        } else if (both) {
+          --count[col];
+        }
+        if (!colDone[col] && count[col]) heap.push(Entry(count[col], col));
+      }
+      target.swap(merged);
+    }
+  }
+  return pivots.size();
+}
+
+template <typename T> size_t
+SparseMatrix<T>::rank() const {
+  std::vector<Row_> rows;
+  std::vector<Pivot_> pivots;
+  return this->eliminate_(rows, pivots, NULL);
+}
+
+// det(A) = sign(p) * product of the pivots, where p maps the row of every
+// pivot to its column.
+template <typename T> T
+SparseMatrix<T>::determinant() const {
+  if (this->row_ != this->col_)
+    throw std::invalid_argument("SparseMatrix::determinant");
+  std::vector<Row_> rows;
+  std::vector<Pivot_> pivots;
+  if (this->eliminate_(rows, pivots, NULL) != this->row_) return T(0);
+  std::vector<size_t> to(this->row_);
+  T result = T(1);
+  for (size_t k = 0; k != pivots.size(); ++k) {
+    to[pivots[k].row] = pivots[k].col;
+    result *= pivots[k].value;
+  }
+  // Every cycle of length l is l - 1 transpositions.
+  std::vector<bool> seen(this->row_, false);
+  bool odd = false;
+  for (size_t i = 0; i != this->row_; ++i)
+    for (size_t j = i; !seen[j]; j = to[j]) {
+      seen[j] = true;
+      if (to[j] != i) odd = !odd;
+    }
+  return odd ? T(0) - result : result;
+}
+
+template <typename T> bool
+SparseMatrix<T>::solve(const T *b, T *x) const {
+  std::vector<Row_> rows;
+  std::vector<Pivot_> pivots;
+  std::vector<T> rhs(b, b + this->row_);
+  this->eliminate_(rows, pivots, rhs.empty() ? NULL : &rhs[0]);
+  std::vector<bool> pivoted(this->row_, false);
+  for (size_t k = 0; k != pivots.size(); ++k) pivoted[pivots[k].row] = true;
+  for (size_t r = 0; r != this->row_; ++r)
+    if (!pivoted[r] && !isZero(rhs[r])) return false;
+  // The pivot row of step k only holds columns pivoted after it.
+  std::fill(x, x + this->col_, T(0));
+  for (size_t k = pivots.size(); k--; ) {
+    const Row_ &row = rows[pivots[k].row];
+    T sum = rhs[pivots[k].row];
+    for (size_t i = 0; i != row.size(); ++i)
+      if (row[i].first != pivots[k].col)
+        sum -= row[i].second * x[row[i].first];
+    x[pivots[k].col] = sum / pivots[k].value;
+  }
+  return true;
+}
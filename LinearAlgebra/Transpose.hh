@@ -0,0 +1,273 @@
+#pragma once
+
+#include <algorithm>  // std::swap
+#include <cstddef>
+// cstdint is a C++11 header.
+#include <stdint.h>
+#include <vector>
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// Transposition of row-major blocks, shared by Matrix<T> and the square
+// Matrix<T, Len, Len>. Strides are in elements.
+// The blocks are cut in halves along the longer side until they fit in the
+// L1 cache, whatever its size is (cache-oblivious), and the leaves are
+// transposed by tiles of TransposeKernel_<T>::side, with SSE2 or AVX for
+// float, double and int.
+
+// Scalar fallback, side 1 means there is no SIMD kernel for T.
+template <typename T>
+struct TransposeKernel_ {
+  static const size_t side = 1;
+  static void run(const T *src, size_t, T *dst, size_t) { *dst = *src; }
+};
+
+#if defined(__AVX__)
+template <>
+struct TransposeKernel_<float> {
+  static const size_t side = 8;
+  static void run(const float *src, size_t ss, float *dst, size_t ds) {
+    const __m256 r0 = _mm256_loadu_ps(src), r1 = _mm256_loadu_ps(src + ss),
+        r2 = _mm256_loadu_ps(src + 2 * ss), r3 = _mm256_loadu_ps(src + 3 * ss),
+        r4 = _mm256_loadu_ps(src + 4 * ss), r5 = _mm256_loadu_ps(src + 5 * ss),
+        r6 = _mm256_loadu_ps(src + 6 * ss), r7 = _mm256_loadu_ps(src + 7 * ss);
+    const __m256 t0 = _mm256_unpacklo_ps(r0, r1),
+        t1 = _mm256_unpackhi_ps(r0, r1),
+        t2 = _mm256_unpacklo_ps(r2, r3), t3 = _mm256_unpackhi_ps(r2, r3),
+        t4 = _mm256_unpacklo_ps(r4, r5), t5 = _mm256_unpackhi_ps(r4, r5),
+        t6 = _mm256_unpacklo_ps(r6, r7), t7 = _mm256_unpackhi_ps(r6, r7);
+    const __m256 u0 = _mm256_shuffle_ps(t0, t2, 0x44),
+        u1 = _mm256_shuffle_ps(t0, t2, 0xee),
+        u2 = _mm256_shuffle_ps(t1, t3, 0x44),
+        u3 = _mm256_shuffle_ps(t1, t3, 0xee),
+        u4 = _mm256_shuffle_ps(t4, t6, 0x44),
+        u5 = _mm256_shuffle_ps(t4, t6, 0xee),
+        u6 = _mm256_shuffle_ps(t5, t7, 0x44),
+        u7 = _mm256_shuffle_ps(t5, t7, 0xee);
+    _mm256_storeu_ps(dst, _mm256_permute2f128_ps(u0, u4, 0x20));
+    _mm256_storeu_ps(dst + ds, _mm256_permute2f128_ps(u1, u5, 0x20));
+    _mm256_storeu_ps(dst + 2 * ds, _mm256_permute2f128_ps(u2, u6, 0x20));
+    _mm256_storeu_ps(dst + 3 * ds, _mm256_permute2f128_ps(u3, u7, 0x20));
+    _mm256_storeu_ps(dst + 4 * ds, _mm256_permute2f128_ps(u0, u4, 0x31));
+    _mm256_storeu_ps(dst + 5 * ds, _mm256_permute2f128_ps(u1, u5, 0x31));
+    _mm256_storeu_ps(dst + 6 * ds, _mm256_permute2f128_ps(u2, u6, 0x31));
+    _mm256_storeu_ps(dst + 7 * ds, _mm256_permute2f128_ps(u3, u7, 0x31));
+  }
+};
+
+// Shuffles do not care about the bits, so int borrows the float kernel.
+template <>
+struct TransposeKernel_<int> {
+  static const size_t side = 8;
+  static void run(const int *src, size_t ss, int *dst, size_t ds) {
+    TransposeKernel_<float>::run(reinterpret_cast<const float *>(src), ss,
+                                 reinterpret_cast<float *>(dst), ds);
+  }
+};
+
+template <>
+struct TransposeKernel_<double> {
+  static const size_t side = 4;
+  static void run(const double *src, size_t ss, double *dst, size_t ds) {
+    const __m256d r0 = _mm256_loadu_pd(src), r1 = _mm256_loadu_pd(src + ss),
+        r2 = _mm256_loadu_pd(src + 2 * ss), r3 = _mm256_loadu_pd(src + 3 * ss);
+    const __m256d t0 = _mm256_unpacklo_pd(r0, r1),
+        t1 = _mm256_unpackhi_pd(r0, r1),
+        t2 = _mm256_unpacklo_pd(r2, r3),
+        t3 = _mm256_unpackhi_pd(r2, r3);
+    _mm256_storeu_pd(dst, _mm256_permute2f128_pd(t0, t2, 0x20));
+    _mm256_storeu_pd(dst + ds, _mm256_permute2f128_pd(t1, t3, 0x20));
+    _mm256_storeu_pd(dst + 2 * ds, _mm256_permute2f128_pd(t0, t2, 0x31));
+    _mm256_storeu_pd(dst + 3 * ds, _mm256_permute2f128_pd(t1, t3, 0x31));
+  }
+};
+#elif defined(__SSE2__)
+template <>
+struct TransposeKernel_<float> {
+  static const size_t side = 4;
+  static void run(const float *src, size_t ss, float *dst, size_t ds) {
+    __m128 r0 = _mm_loadu_ps(src), r1 = _mm_loadu_ps(src + ss),
+        r2 = _mm_loadu_ps(src + 2 * ss), r3 = _mm_loadu_ps(src + 3 * ss);
+    _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+    _mm_storeu_ps(dst, r0);
+    _mm_storeu_ps(dst + ds, r1);
+    _mm_storeu_ps(dst + 2 * ds, r2);
+    _mm_storeu_ps(dst + 3 * ds, r3);
+  }
+};
+
+template <>
+struct TransposeKernel_<int> {
+  static const size_t side = 4;
+  static void run(const int *src, size_t ss, int *dst, size_t ds) {
+    const __m128i r0 = load_(src), r1 = load_(src + ss),
+        r2 = load_(src + 2 * ss), r3 = load_(src + 3 * ss);
+    const __m128i t0 = _mm_unpacklo_epi32(r0, r1),
+        t1 = _mm_unpacklo_epi32(r2, r3),
+        t2 = _mm_unpackhi_epi32(r0, r1),
+        t3 = _mm_unpackhi_epi32(r2, r3);
+    store_(dst, _mm_unpacklo_epi64(t0, t1));
+    store_(dst + ds, _mm_unpackhi_epi64(t0, t1));
+    store_(dst + 2 * ds, _mm_unpacklo_epi64(t2, t3));
+    store_(dst + 3 * ds, _mm_unpackhi_epi64(t2, t3));
+  }
+
+ private:
+  static __m128i load_(const int *p) {
+    return _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+  }
+  static void store_(int *p, __m128i x) {
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(p), x);
+  }
+};
+
+// Four 2 x 2 transposes.
+template <>
+struct TransposeKernel_<double> {
+  static const size_t side = 4;
+  static void run(const double *src, size_t ss, double *dst, size_t ds) {
+    for (size_t i = 0; i != 4; i += 2)
+      for (size_t j = 0; j != 4; j += 2) {
+        const __m128d a = _mm_loadu_pd(src + i * ss + j),
+            b = _mm_loadu_pd(src + (i + 1) * ss + j);
+        _mm_storeu_pd(dst + j * ds + i, _mm_unpacklo_pd(a, b));
+        _mm_storeu_pd(dst + (j + 1) * ds + i, _mm_unpackhi_pd(a, b));
+      }
+  }
+};
+#endif  // __AVX__, __SSE2__
+
+// Below this many elements a side, a block is a leaf of the recursion.
+// 32 x 32 doubles in and out are 16KB, which is half of a typical L1.
+static const size_t transposeLeafSide_ = 32;
+
+template <typename T> void
+transposeScalar_(const T *src, size_t ss, T *dst, size_t ds,
+                 size_t row, size_t col) {
+  for (size_t r = 0; r != row; ++r)
+    for (size_t c = 0; c != col; ++c) dst[c * ds + r] = src[r * ss + c];
+}
+
+template <typename T> void
+transposeLeaf_(const T *src, size_t ss, T *dst, size_t ds,
+               size_t row, size_t col) {
+  typedef TransposeKernel_<T> Kernel;
+  const size_t side = Kernel::side;
+  if (side == 1) return transposeScalar_(src, ss, dst, ds, row, col);
+  const size_t tileRow = row / side * side, tileCol = col / side * side;
+  for (size_t r = 0; r != tileRow; r += side)
+    for (size_t c = 0; c != tileCol; c += side)
+      Kernel::run(src + r * ss + c, ss, dst + c * ds + r, ds);
+  transposeScalar_(src + tileCol, ss, dst + tileCol * ds, ds,
+                   row, col - tileCol);
+  transposeScalar_(src + tileRow * ss, ss, dst + tileRow, ds,
+                   row - tileRow, tileCol);
+}
+
+// dst = transpose of the row x col block src. They must not overlap.
+template <typename T> void
+transposeTo_(const T *src, size_t ss, T *dst, size_t ds,
+             size_t row, size_t col) {
+  if (row <= transposeLeafSide_ && col <= transposeLeafSide_)
+    return transposeLeaf_(src, ss, dst, ds, row, col);
+  // Cuts at a multiple of the tile, so that the halves tile evenly.
+  if (row >= col) {
+    const size_t half = row / 2 / 8 * 8;
+    transposeTo_(src, ss, dst, ds, half, col);
+    transposeTo_(src + half * ss, ss, dst + half, ds, row - half, col);
+  } else {
+    const size_t half = col / 2 / 8 * 8;
+    transposeTo_(src, ss, dst, ds, row, half);
+    transposeTo_(src + half, ss, dst + half * ds, ds, row, col - half);
+  }
+}
+
+// Swaps the row x col block a with the transpose of the col x row block b,
+// both in the same matrix. They must not overlap.
+template <typename T> void
+transposeSwap_(T *a, T *b, size_t stride, size_t row, size_t col) {
+  using std::swap;
+  if (row > transposeLeafSide_ || col > transposeLeafSide_) {
+    if (row >= col) {
+      const size_t half = row / 2 / 8 * 8;
+      transposeSwap_(a, b, stride, half, col);
+      transposeSwap_(a + half * stride, b + half, stride, row - half, col);
+    } else {
+      const size_t half = col / 2 / 8 * 8;
+      transposeSwap_(a, b, stride, row, half);
+      transposeSwap_(a + half, b + half * stride, stride, row, col - half);
+    }
+    return;
+  }
+  typedef TransposeKernel_<T> Kernel;
+  const size_t side = Kernel::side;
+  if (side == 1) {
+    for (size_t r = 0; r != row; ++r)
+      for (size_t c = 0; c != col; ++c)
+        swap(a[r * stride + c], b[c * stride + r]);
+    return;
+  }
+  // Tile by tile through a buffer: a goes to the buffer, b to a, then
+  // the buffer to b.
+  T buffer[Kernel::side * Kernel::side];
+  const size_t tileRow = row / side * side, tileCol = col / side * side;
+  for (size_t r = 0; r != tileRow; r += side)
+    for (size_t c = 0; c != tileCol; c += side) {
+      T *const x = a + r * stride + c, *const y = b + c * stride + r;
+      Kernel::run(x, stride, buffer, side);
+      Kernel::run(y, stride, x, stride);
+      for (size_t i = 0; i != side; ++i)
+        for (size_t j = 0; j != side; ++j)
+          y[i * stride + j] = buffer[i * side + j];
+    }
+  for (size_t r = 0; r != row; ++r)
+    for (size_t c = r < tileRow ? tileCol : 0; c != col; ++c)
+      swap(a[r * stride + c], b[c * stride + r]);
+}
+
+// Transposes the len x len block in place.
+template <typename T> void
+transposeSquare_(T *value, size_t stride, size_t len) {
+  using std::swap;
+  if (len <= transposeLeafSide_) {
+    for (size_t i = 0; i != len; ++i)
+      for (size_t j = i + 1; j != len; ++j)
+        swap(value[i * stride + j], value[j * stride + i]);
+    return;
+  }
+  const size_t half = len / 2 / 8 * 8;
+  transposeSquare_(value, stride, half);
+  transposeSquare_(value + half * stride + half, stride, len - half);
+  transposeSwap_(value + half, value + half * stride, stride, half, len - half);
+}
+
+// Transposes the packed row x col array in place, i.e. it becomes col x row.
+// The element at i goes to i * row mod (row * col - 1), and every cycle of
+// this permutation is followed once, marked by one bit per element.
+// i * row is taken in 64 bits, it overflows a 32-bit size_t from 4096 x
+// 4096 on.
+// Slower than transposeTo_ for its random access, use it when a second
+// buffer does not fit.
+template <typename T> void
+transposeCycles_(T *value, size_t row, size_t col) {
+  using std::swap;
+  const size_t size = row * col;
+  if (size < 3) return;
+  const size_t last = size - 1;
+  std::vector<bool> done(size);
+  for (size_t start = 1; start != last; ++start) {
+    if (done[start]) continue;
+    T carry = value[start];
+    size_t i = start;
+    do {
+      const size_t next = static_cast<size_t>(
+          static_cast<uint64_t>(i) * row % last);
+      swap(carry, value[next]);
+      done[i] = true;
+      i = next;
+    } while (i != start);
+  }
+}
@@ -1,7 +1,14 @@
 #pragma once
 
+#include <new>  // placement new
 #include <stdexcept>
+// cstdint is a C++11 header.
+#include <stdint.h>
+#include <vector>
 #include "MatrixDecl.hh"
+#include "MatrixExpression.hh"
+#include "MatrixView.hh"
+#include "Transpose.hh"
 
 template <typename T> Matrix<T> &
 operator+=(Matrix<T> &, const Matrix<T> &);
@@ -13,6 +20,14 @@ template <typename T> bool
 operator==(const Matrix<T> &, const Matrix<T> &);
 template <typename T> bool
 operator!=(const Matrix<T> &, const Matrix<T> &);
+template <typename T> class MatrixWorkspace;
+
+// How Matrix<T> lays out its rows. Every buffer starts at a 64-byte (cache
+// line) boundary. PackedRows follow one another, i.e. the stride is col().
+// PaddedRows also start at cache line boundaries, and the stride grows by
+// one more cache line when it would be a multiple of 4KB, which maps every
+// row of a column onto the same cache set (4K aliasing).
+enum MatrixStorage { PackedRows, PaddedRows };
 
 // Matrix<T, 0, 0> is a variable-sized matrix,
 // which has the ability to change size at runtime.
@@ -30,11 +45,16 @@ class Matrix<T, 0, 0> {
   Matrix &operator=(Matrix &&);
 #endif  // __cplusplus >= 201103L
   ~Matrix(); 
-  Matrix(size_t, size_t);
+  Matrix(size_t, size_t, MatrixStorage = PackedRows);
 
 #if __cplusplus >= 201103L
   template <typename Head, typename ...Tail, size_t Col>
   Matrix(const Head (&)[Col], const Tail (&...tail)[Col]);
+  // Evaluates A + B * C and the like in place, see MatrixExpression.hh.
+  template <typename Expr, typename = typename Expr::IsMatrixExpression>
+  Matrix(const Expr &);
+  template <typename Expr, typename = typename Expr::IsMatrixExpression>
+  Matrix &operator=(const Expr &);
 #endif  // __cplusplus >= 201103L
 
   Matrix &copyFrom(const Matrix &);
@@ -52,26 +72,151 @@ class Matrix<T, 0, 0> {
 
   size_t row() const;
   size_t col() const;
+  // Distance between the beginnings of two adjacent rows, in elements.
+  size_t stride() const;
+  MatrixStorage storage() const;
 
   Matrix &transpose();
+  Matrix &transposeInPlace();
   Matrix &triangularize();
   Matrix &eliminate();
   Matrix &inverse();
   T determinant() const;
+  // The same as above, but borrow the scratch memory from the workspace,
+  // so that calling them in a loop allocates nothing.
+  Matrix &triangularize(MatrixWorkspace<T> &);
+  Matrix &eliminate(MatrixWorkspace<T> &);
+  Matrix &inverse(MatrixWorkspace<T> &);
+  T determinant(MatrixWorkspace<T> &) const;
+  // With a pivoting policy of MatrixDecl.hh instead of DefaultPivot_.
+  // Those which swap columns (CompletePivot, RookPivot) only make sense
+  // for determinant, the others do not compile with them.
+  template <typename Pivot> Matrix &triangularize(Pivot);
+  template <typename Pivot> Matrix &eliminate(Pivot);
+  template <typename Pivot> T determinant(Pivot) const;
+  template <typename Pivot>
+  Matrix &triangularize(Pivot, MatrixWorkspace<T> &);
+  template <typename Pivot> Matrix &eliminate(Pivot, MatrixWorkspace<T> &);
+  template <typename Pivot> T determinant(Pivot, MatrixWorkspace<T> &) const;
+  // det(xI - A), from the constant term up.
+  std::vector<T> characteristicPolynomial() const;
+  // From a single elimination with EchelonPivot_, see echelon_. solve
+  // returns false if there is no solution, leastSquares is for float and
+  // double, see leastSquaresOf_.
+  size_t rank() const;
+  std::vector<size_t> pivotColumns() const;
+  std::vector<std::vector<T> > nullspace() const;
+  bool solve(const std::vector<T> &, std::vector<T> &) const;
+  std::vector<T> leastSquares(const std::vector<T> &) const;
+
+  // Views on the elements without copying, see MatrixView.hh.
+  MatrixView<T> view();
+  MatrixView<const T> view() const;
+  MatrixView<T> block(size_t, size_t, size_t, size_t);
+  MatrixView<const T> block(size_t, size_t, size_t, size_t) const;
+  MatrixView<T> row(size_t);
+  MatrixView<const T> row(size_t) const;
+  MatrixView<T> col(size_t);
+  MatrixView<const T> col(size_t) const;
+  MatrixView<T> transposed();
+  MatrixView<const T> transposed() const;
 
  private:
-  size_t row_, col_;
+  size_t row_, col_, stride_;
+  MatrixStorage storage_;
   T *value;
+
+  static size_t strideOf_(size_t, MatrixStorage);
+  static T *allocate_(size_t);
+  static void deallocate_(T *, size_t);
 };
 
+// Scratch memory of the eliminations of Matrix<T>: the row pointers,
+// the pivots, and a copy of the matrix for determinant.
+// It only grows, reuse one for matrices of similar sizes.
+template <typename T>
+class MatrixWorkspace {
+ public:
+  friend class Matrix<T>;
+
+ private:
+  std::vector<T *> rows_;
+  std::vector<size_t> pivot_;
+  std::vector<T> values_;
+
+  T **rowsOf_(T *, size_t, size_t);
+  size_t *pivotOf_(size_t);
+  T *valuesOf_(size_t);
+};
+
+template <typename T> T **
+MatrixWorkspace<T>::rowsOf_(T *value, size_t row, size_t stride) {
+  if (this->rows_.size() < row) this->rows_.resize(row);
+  for (size_t i = 0; i != row; ++i)
+    this->rows_[i] = value + i * stride;
+  return row ? &this->rows_[0] : NULL;
+}
+
+template <typename T> size_t *
+MatrixWorkspace<T>::pivotOf_(size_t len) {
+  if (this->pivot_.size() < len) this->pivot_.resize(len);
+  return len ? &this->pivot_[0] : NULL;
+}
+
+template <typename T> T *
+MatrixWorkspace<T>::valuesOf_(size_t size) {
+  if (this->values_.size() < size) this->values_.resize(size);
+  return size ? &this->values_[0] : NULL;
+}
+
+template <typename T> size_t
+Matrix<T>::strideOf_(size_t col, MatrixStorage storage) {
+  if (storage == PackedRows || 64 % sizeof(T)) return col;
+  const size_t line = 64 / sizeof(T);
+  size_t stride = (col + line - 1) / line * line;
+  if (stride * sizeof(T) % 4096 == 0) stride += line;
+  return stride;
+}
+
+// Allocates size elements (default-initialized, as new T[size] does)
+// on a cache line. The address returned by operator new is kept just
+// before the elements.
+template <typename T> T *
+Matrix<T>::allocate_(size_t size) {
+  if (!size) return NULL;
+  const size_t align = 64, extra = align + sizeof(void *);
+  char *const raw =
+      static_cast<char *>(::operator new(size * sizeof(T) + extra));
+  char *aligned = raw + sizeof(void *);
+  aligned += (align - reinterpret_cast<uintptr_t>(aligned) % align) % align;
+  reinterpret_cast<void **>(aligned)[-1] = raw;
+  T *const value = reinterpret_cast<T *>(aligned);
+  size_t i = 0;
+  try {
+    for (; i != size; ++i) new (value + i) T;
+  } catch (...) {
+    while (i) value[--i].~T();
+    ::operator delete(raw);
+    throw;
+  }
+  return value;
+}
+
+template <typename T> void
+Matrix<T>::deallocate_(T *value, size_t size) {
+  if (!value) return;
+  while (size) value[--size].~T();
+  ::operator delete(reinterpret_cast<void **>(value)[-1]);
+}
+
 template <typename T>
 Matrix<T>::Matrix()
-    : row_(0), col_(0), value(NULL) {
+    : row_(0), col_(0), stride_(0), storage_(PackedRows), value(NULL) {
 }
 
 template <typename T>
 Matrix<T>::Matrix(const Matrix &that)
-    : row_(0), col_(0), value(NULL) {
+    : row_(0), col_(0), stride_(0), storage_(PackedRows), value(NULL) {
   this->copyFrom(that);
 }
 
@@ -84,7 +229,7 @@ Matrix<T> &Matrix<T>::operator=(const Matrix &that) {
 #if __cplusplus >= 201103L
 template <typename T>
 Matrix<T>::Matrix(Matrix &&that)
-    : value{nullptr} {
+    : row_{0}, col_{0}, stride_{0}, storage_{PackedRows}, value{nullptr} {
   this->moveFrom(that);
 }
 
@@ -97,69 +242,107 @@ Matrix<T> &Matrix<T>::operator=(Matrix &&that) {
 
 template <typename T>
 Matrix<T>::~Matrix() {
-  delete[] this->value;
+  deallocate_(this->value, this->row_ * this->stride_);
   this->value = NULL;
 }
 
 template <typename T>
-Matrix<T>::Matrix(size_t row, size_t col)
-    : row_(row), col_(col) {
-  this->value = new T[row * col];
+Matrix<T>::Matrix(size_t row, size_t col, MatrixStorage storage)
+    : row_(row), col_(col), stride_(strideOf_(col, storage)),
+      storage_(storage) {
+  this->value = allocate_(row * this->stride_);
 }
 
 #if __cplusplus >= 201103L
 template <typename T> template <typename Head, typename ...Tail, size_t Col>
 Matrix<T>::Matrix(const Head (&head)[Col], const Tail (&...tail)[Col])
-    : row_{sizeof...(tail) + 1}, col_{Col} {
+    : row_{sizeof...(tail) + 1}, col_{Col}, stride_{Col},
+      storage_{PackedRows} {
   const Head *array[sizeof...(tail) + 1] = { head, tail... };
-  this->value = new T[this->row_ * this->col_];
+  this->value = allocate_(this->row_ * this->col_);
   for (size_t r = 0; r != this->row_; ++r)
     std::copy(array[r], array[r] + Col, this->value + r * Col);
 }
+
+template <typename T> template <typename Expr, typename>
+Matrix<T>::Matrix(const Expr &expr)
+    : row_{expr.row()}, col_{expr.col()}, stride_{expr.col()},
+      storage_{PackedRows} {
+  static_assert(std::is_same<typename Expr::Value, T>::value,
+                "Type not match");
+  this->value = allocate_(this->row_ * this->col_);
+  expr.template assignTo<false>(*this);
+}
+
+// Reuses the buffer unless the size changes or the expression is a product
+// reading this matrix. The storage is kept either way.
+template <typename T> template <typename Expr, typename>
+Matrix<T> &Matrix<T>::operator=(const Expr &expr) {
+  static_assert(std::is_same<typename Expr::Value, T>::value,
+                "Type not match");
+  if (expr.clobbers(spanOf_(*this)) || expr.row() != this->row_
+      || expr.col() != this->col_) {
+    Matrix result(expr.row(), expr.col(), this->storage_);
+    expr.template assignTo<false>(result);
+    return this->moveFrom(result);
+  }
+  expr.template assignTo<false>(*this);
+  return *this;
+}
 #endif  // __cplusplus >= 201103L
 
+// Takes the storage of that, and the buffer is reused if it fits exactly.
 template <typename T> Matrix<T> &
 Matrix<T>::copyFrom(const Matrix &that) {
-  const size_t new_size = that.row_ * that.col_;
-  const size_t old_size = this->row_ * this->col_;
-  this->row_ = that.row_;
-  this->col_ = that.col_;
+  if (this == &that) return *this;
+  const size_t new_size = that.row_ * that.stride_;
+  const size_t old_size = this->row_ * this->stride_;
   if (new_size != old_size) {
-    delete[] this->value;
-    this->value = new T[new_size];
+    deallocate_(this->value, old_size);
+    this->row_ = this->stride_ = 0;
+    this->value = NULL;
+    this->value = allocate_(new_size);
   }
-  std::copy(that.value, that.value + new_size, this->value);
+  this->row_ = that.row_;
+  this->col_ = that.col_;
+  this->stride_ = that.stride_;
+  this->storage_ = that.storage_;
+  for (size_t r = 0; r != this->row_; ++r)
+    std::copy(that[r], that[r] + this->col_, (*this)[r]);
   return *this;
 }
 
 template <typename T> Matrix<T> &
 Matrix<T>::moveFrom(Matrix &that) {
+  if (this == &that) return *this;
+  deallocate_(this->value, this->row_ * this->stride_);
   this->row_ = that.row_;
   this->col_ = that.col_;
-  delete[] this->value;
+  this->stride_ = that.stride_;
+  this->storage_ = that.storage_;
   this->value = that.value;
-  that.row_ = that.col_ = 0;
+  that.row_ = that.col_ = that.stride_ = 0;
   that.value = NULL;
   return *this;
 }
 
+// Keeps the storage of this matrix.
 template <typename T> template <size_t Row, size_t Col> Matrix<T> &
 Matrix<T>::copyFromArray(const T (&arr)[Row][Col]) {
-  const size_t size = Row * Col;
-  this->row_ = Row; this->col_ = Col;
-  this->value = new T[size];
-  std::copy(*arr, *arr + size, this->value);
-  return *this;
+  Matrix result(Row, Col, this->storage_);
+  for (size_t r = 0; r != Row; ++r)
+    std::copy(arr[r], arr[r] + Col, result[r]);
+  return this->moveFrom(result);
 }
 
 template <typename T> T *
 Matrix<T>::operator[](size_t row) {
-  return &this->value[row * this->col_];
+  return &this->value[row * this->stride_];
 }
 
 template <typename T> const T *
 Matrix<T>::operator[](size_t row) const {
-  return &this->value[row * this->col_];
+  return &this->value[row * this->stride_];
 }
 
 
@@ -167,12 +350,13 @@ template <typename T> Matrix<T, 0, 0> &
 operator+=(Matrix<T, 0, 0> &lhs, const Matrix<T, 0, 0> &rhs) {
   if (lhs.row_ != rhs.row_ || lhs.col_ != rhs.col_)
     throw std::invalid_argument("Matrix<T>::operator+=");
-  const size_t size = lhs.row_ * lhs.col_;
-  std::transform(lhs.value, lhs.value + size,
-                 rhs.value, lhs.value, std::plus<T>());
+  for (size_t r = 0; r != lhs.row_; ++r)
+    std::transform(lhs[r], lhs[r] + lhs.col_, rhs[r], lhs[r], std::plus<T>());
   return lhs;
 }
 
+// Since C++11 operator+, - and * are lazy, see MatrixExpression.hh.
+#if __cplusplus < 201103L
 template <typename T> Matrix<T>
 operator+(const Matrix<T> &lhs, const Matrix<T> &rhs) {
   if (lhs.row() != rhs.row() || lhs.col() != rhs.col())
@@ -180,17 +364,18 @@ operator+(const Matrix<T> &lhs, const Matrix<T> &rhs) {
   Matrix<T> result = lhs;
   return result += rhs;
 }
+#endif  // __cplusplus < 201103L
 
 template <typename T> Matrix<T> &
 operator-=(Matrix<T> &lhs, const Matrix<T> &rhs) {
   if (lhs.row_ != rhs.row_ || lhs.col_ != rhs.col_)
     throw std::invalid_argument("Matrix<T>::operator-=");
-  const size_t size = lhs.row_ * lhs.col_;
-  std::transform(lhs.value, lhs.value + size,
-                 rhs.value, lhs.value, std::minus<T>());
+  for (size_t r = 0; r != lhs.row_; ++r)
+    std::transform(lhs[r], lhs[r] + lhs.col_, rhs[r], lhs[r], std::minus<T>());
   return lhs;
 }
 
+#if __cplusplus < 201103L
 template <typename T> Matrix<T>
 operator-(const Matrix<T> &lhs, const Matrix<T> &rhs) {
   if (lhs.row() != rhs.row() || lhs.col() != rhs.col())
@@ -198,20 +383,23 @@ operator-(const Matrix<T> &lhs, const Matrix<T> &rhs) {
   Matrix<T> result = lhs;
   return result -= rhs;
 }
+#endif  // __cplusplus < 201103L
 
 template <typename T> Matrix<T> &
 operator*=(Matrix<T> &lhs, const Matrix<T> &rhs) {
   if (lhs.col_ != rhs.row_)
     throw std::invalid_argument("Matrix<T>::operator*=");
-  Matrix<T> result(lhs.row_, rhs.col_);
-  std::fill(result.value, result.value + result.row_ * result.col_, 0);
-  for (size_t r = 0; r != result.row_; ++r)
+  Matrix<T> result(lhs.row_, rhs.col_, lhs.storage_);
+  for (size_t r = 0; r != result.row_; ++r) {
+    std::fill(result[r], result[r] + result.col_, 0);
     for (size_t c = 0; c != result.col_; ++c)
       for (size_t i = 0; i != lhs.col_; ++i)
         result[r][c] += lhs[r][i] * rhs[i][c];
+  }
   return lhs.moveFrom(result);
 }
 
+#if __cplusplus < 201103L
 template <typename T> Matrix<T>
 operator*(const Matrix<T> &lhs, const Matrix<T> &rhs) {
   if (lhs.col() != rhs.row())
@@ -219,6 +407,7 @@ operator*(const Matrix<T> &lhs, const Matrix<T> &rhs) {
   Matrix<T> result = lhs;
   return result *= rhs;
 }
+#endif  // __cplusplus < 201103L
 
 template <typename T> size_t
 Matrix<T>::row() const {
@@ -230,99 +419,253 @@ Matrix<T>::col() const {
   return this->col_;
 }
 
+template <typename T> size_t
+Matrix<T>::stride() const {
+  return this->stride_;
+}
+
+template <typename T> MatrixStorage
+Matrix<T>::storage() const {
+  return this->storage_;
+}
+
+// Any shape. Square matrices are transposed in place, block by block,
+// others are written to a new buffer of the same storage.
 template <typename T> Matrix<T> &
 Matrix<T>::transpose() {
-  if (this->row_ != this->col_)
-    throw std::invalid_argument("Matrix<T>::transpose");
-  const size_t row = this->row_, col = this->col;
-  T *const &value = this->value;
-  for (size_t i = 0; i != row; ++i)
-    for (size_t j = i + 1; j != col; ++j)
-      std::swap(value[i * col + j], value[j * col + i]);
+  if (this->row_ == this->col_) {
+    transposeSquare_(this->value, this->stride_, this->row_);
+    return *this;
+  }
+  Matrix result(this->col_, this->row_, this->storage_);
+  transposeTo_(this->value, this->stride_, result.value, result.stride_,
+               this->row_, this->col_);
+  return this->moveFrom(result);
+}
+
+// The same as transpose, but a packed rectangular matrix is permuted in
+// place, which needs one bit per element instead of a second buffer and
+// is several times slower. Padded rows do not fit the new shape, so they
+// still go through transpose.
+template <typename T> Matrix<T> &
+Matrix<T>::transposeInPlace() {
+  if (this->row_ == this->col_ || this->stride_ != this->col_)
+    return this->transpose();
+  transposeCycles_(this->value, this->row_, this->col_);
+  std::swap(this->row_, this->col_);
+  this->stride_ = this->col_;
   return *this;
 }
 
 template <typename T> Matrix<T> &
 Matrix<T>::triangularize() {
-  const size_t row = this->row_, col = this->col_;
-  T **matrix = new T *[row];
-  for (size_t i = 0; i != row; ++i)
-    matrix[i] = this->value + i * col;
-  triangularize_(matrix, row, col);
-  T *value = new T[row * col];
-  for (size_t r = 0; r != row; ++r)
-    ifCpp11MoveElseCopy(matrix[r], matrix[r] + col, value + r * col);
-  delete[] matrix, delete[] this->value;
-  this->value = value;
-  return *this;
+  MatrixWorkspace<T> workspace;
+  return this->triangularize(workspace);
 }
 
 template <typename T> Matrix<T> &
 Matrix<T>::eliminate() {
+  MatrixWorkspace<T> workspace;
+  return this->eliminate(workspace);
+}
+
+template <typename T> Matrix<T> &
+Matrix<T>::inverse() {
+  MatrixWorkspace<T> workspace;
+  return this->inverse(workspace);
+}
+
+template <typename T> T
+Matrix<T>::determinant() const {
+  MatrixWorkspace<T> workspace;
+  return this->determinant(workspace);
+}
+
+template <typename T> Matrix<T> &
+Matrix<T>::triangularize(MatrixWorkspace<T> &workspace) {
+  return this->triangularize(typename DefaultPivot_<T>::type(), workspace);
+}
+
+template <typename T> Matrix<T> &
+Matrix<T>::eliminate(MatrixWorkspace<T> &workspace) {
+  return this->eliminate(typename DefaultPivot_<T>::type(), workspace);
+}
+
+template <typename T> template <typename Pivot> Matrix<T> &
+Matrix<T>::triangularize(Pivot pivot) {
+  MatrixWorkspace<T> workspace;
+  return this->triangularize(pivot, workspace);
+}
+
+template <typename T> template <typename Pivot> Matrix<T> &
+Matrix<T>::eliminate(Pivot pivot) {
+  MatrixWorkspace<T> workspace;
+  return this->eliminate(pivot, workspace);
+}
+
+template <typename T> template <typename Pivot> T
+Matrix<T>::determinant(Pivot pivot) const {
+  MatrixWorkspace<T> workspace;
+  return this->determinant(pivot, workspace);
+}
+
+// Eliminates in place, the pivoting only permutes the row pointers,
+// which are put back by permuteRows_ at last.
+template <typename T> template <typename Pivot> Matrix<T> &
+Matrix<T>::triangularize(Pivot pivot, MatrixWorkspace<T> &workspace) {
   const size_t row = this->row_, col = this->col_;
-  T **matrix = new T *[row];
-  for (size_t i = 0; i != row; ++i)
-    matrix[i] = this->value + i * col;
-  triangularize_(matrix, row, col);
+  (void)sizeof(PivotKeepsColumns_<!Pivot::swapsColumns>);
+  T **matrix = workspace.rowsOf_(this->value, row, this->stride_);
+  triangularize_(matrix, row, col, pivot, NULL);
+  permuteRows_(matrix, this->value, row, col, this->stride_);
+  return *this;
+}
+
+template <typename T> template <typename Pivot> Matrix<T> &
+Matrix<T>::eliminate(Pivot pivot, MatrixWorkspace<T> &workspace) {
+  const size_t row = this->row_, col = this->col_;
+  (void)sizeof(PivotKeepsColumns_<!Pivot::swapsColumns>);
+  T **matrix = workspace.rowsOf_(this->value, row, this->stride_);
+  triangularize_(matrix, row, col, pivot, NULL);
   canonicalize_(matrix, row, col);
-  T *value = new T[row * col];
-  for (size_t r = 0; r != row; ++r)
-    ifCpp11MoveElseCopy(matrix[r], matrix[r] + col, value + r * col);
-  delete[] matrix, delete[] this->value;
-  this->value = value;
+  permuteRows_(matrix, this->value, row, col, this->stride_);
   return *this;
 }
 
+// In-place Gauss-Jordan, see inverse_.
+// Throws std::invalid_argument if not inversible, and the matrix is
+// unspecified then.
 template <typename T> Matrix<T> &
-Matrix<T>::inverse() {
+Matrix<T>::inverse(MatrixWorkspace<T> &workspace) {
   const size_t row = this->row_, col = this->col_;
-  T *const value = this->value;
   if (row != col)
     throw std::invalid_argument("Matrix<T>::inverse");
-
-  T *concat = new T[row * col * 2];
-  T **matrix = new T *[row];
-
-  for (size_t i = 0; i != row; ++i) {
-    matrix[i] = concat + i * col * 2;
-    ifCpp11MoveElseCopy(value + i * col, value + i * col + col, matrix[i]);
-    std::fill(matrix[i] + col, matrix[i] + col * 2, 0);
-    matrix[i][col + i] = 1;
-  }
-  triangularize_(matrix, row, col * 2);
-
-  for (size_t i = 0; i != row; ++i)
-    if (isZero(matrix[i][i])) {
-      delete[] matrix, delete[] concat;
-      throw std::invalid_argument("Matrix::inverse");
-    }
-  canonicalize_(matrix, row, col * 2);
-  for (size_t i = 0; i != row; ++i)
-    ifCpp11MoveElseCopy(matrix[i] + col, matrix[i] + col * 2, value + i * col);
-
-  delete[] matrix, delete[] concat;
+  T **matrix = workspace.rowsOf_(this->value, row, this->stride_);
+  if (!inverse_(matrix, row, workspace.pivotOf_(row)))
+    throw std::invalid_argument("Matrix::inverse");
+  permuteRows_(matrix, this->value, row, col, this->stride_);
   return *this;
 }
 
 template <typename T> T
-Matrix<T>::determinant() const {
+Matrix<T>::determinant(MatrixWorkspace<T> &workspace) const {
+  return this->determinant(typename DefaultPivot_<T>::type(), workspace);
+}
+
+template <typename T> template <typename Pivot> T
+Matrix<T>::determinant(Pivot pivot, MatrixWorkspace<T> &workspace) const {
   const size_t row = this->row_, col = this->col_;
   if (row != col)
     throw std::invalid_argument("Matrix<T>::determinant");
-  Matrix temporary = *this;
-  T **matrix = new T *[row];
-  for (size_t i = 0; i != row; ++i)
-    matrix[i] = temporary.value + i * col;
-  T result = triangularize_(matrix, row, col) ? 1 : -1;
-  for (size_t i = 0; i != row; ++i)
-    if (!isZero(result)) result *= matrix[i][i];
-  delete[] matrix;
-  return isZero(result) ? 0 : result;
+  T *const value = workspace.valuesOf_(row * col);
+  for (size_t r = 0; r != row; ++r)
+    std::copy((*this)[r], (*this)[r] + col, value + r * col);
+  T **matrix = workspace.rowsOf_(value, row, col);
+  T result = triangularize_(matrix, row, col, pivot, NULL) ? 1 : -1;
+  for (size_t i = 0; i != row && !(result == T(0)); ++i)
+    result *= matrix[i][i];
+  return result;
+}
+
+template <typename T> size_t
+Matrix<T>::rank() const {
+  return rankOf_<T>(*this);
+}
+
+template <typename T> std::vector<size_t>
+Matrix<T>::pivotColumns() const {
+  return pivotColumnsOf_<T>(*this);
+}
+
+template <typename T> std::vector<std::vector<T> >
+Matrix<T>::nullspace() const {
+  return nullspaceOf_<T>(*this);
+}
+
+template <typename T> bool
+Matrix<T>::solve(const std::vector<T> &b, std::vector<T> &x) const {
+  return solveOf_(*this, b, x);
+}
+
+template <typename T> std::vector<T>
+Matrix<T>::leastSquares(const std::vector<T> &b) const {
+  return leastSquaresOf_(*this, b);
+}
+
+// Hessenberg reduction then its recurrence, see characteristicPolynomial_.
+// Throws std::invalid_argument if not square.
+template <typename T> std::vector<T>
+Matrix<T>::characteristicPolynomial() const {
+  const size_t len = this->row_;
+  if (len != this->col_)
+    throw std::invalid_argument("Matrix<T>::characteristicPolynomial");
+  std::vector<T> value(len * len), poly((len + 1) * (len + 1));
+  std::vector<T *> matrix(len + 1);
+  for (size_t r = 0; r != len; ++r) {
+    std::copy((*this)[r], (*this)[r] + len, &value[r * len]);
+    matrix[r] = &value[r * len];
+  }
+  const T *const result = characteristicPolynomial_(&matrix[0], len, &poly[0]);
+  return std::vector<T>(result, result + len + 1);
 }
 
 template <typename T> bool
 operator==(const Matrix<T> &lhs, const Matrix<T> &rhs) {
   if (lhs.row_ != rhs.row_) return false;
   if (lhs.col_ != rhs.col_) return false;
-  return std::equal(lhs.value, lhs.value + lhs.row_ * lhs.col_, rhs.value);
+  for (size_t r = 0; r != lhs.row_; ++r)
+    if (!std::equal(lhs[r], lhs[r] + lhs.col_, rhs[r])) return false;
+  return true;
+}
+
+template <typename T> MatrixView<T>
+Matrix<T>::view() {
+  return MatrixView<T>(this->value, this->row_, this->col_,
+                       this->stride_, 1);
+}
+
+template <typename T> MatrixView<const T>
+Matrix<T>::view() const {
+  return MatrixView<const T>(this->value, this->row_, this->col_,
+                       this->stride_, 1);
+}
+
+template <typename T> MatrixView<T>
+Matrix<T>::block(size_t r, size_t c, size_t h, size_t w) {
+  return this->view().block(r, c, h, w);
+}
+
+template <typename T> MatrixView<const T>
+Matrix<T>::block(size_t r, size_t c, size_t h, size_t w) const {
+  return this->view().block(r, c, h, w);
+}
+
+template <typename T> MatrixView<T>
+Matrix<T>::row(size_t r) {
+  return this->view().row(r);
+}
+
+template <typename T> MatrixView<const T>
+Matrix<T>::row(size_t r) const {
+  return this->view().row(r);
+}
+
+template <typename T> MatrixView<T>
+Matrix<T>::col(size_t c) {
+  return this->view().col(c);
+}
+
+template <typename T> MatrixView<const T>
+Matrix<T>::col(size_t c) const {
+  return this->view().col(c);
+}
+
+template <typename T> MatrixView<T>
+Matrix<T>::transposed() {
+  return this->view().transposed();
+}
+
+template <typename T> MatrixView<const T>
+Matrix<T>::transposed() const {
+  return this->view().transposed();
 }
@@ -1,18 +1,289 @@
 #pragma once
 
 #include <algorithm>
-#include <numeric>
+#include <cmath>  // std::sqrt
+#include <stdexcept>
+#include <vector>
+#ifdef _OPENMP
+#include <omp.h>
+#endif  // _OPENMP
+#if __cplusplus >= 201103L
+#include <type_traits>
+#include <utility>
+#endif  // __cplusplus >= 201103L
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 #include "Matrix.hh"
+#include "VariableMatrix.hh"
 
 // The only use of this Vector is to multiply with Matrix.
 // The 3-dimension vector should be a specialization of this class,
 // and be defined at ComputationalGeometry (if I write. Well, OK, TODO).
+// Vector<T> (Len is 0) is sized at runtime, see below.
 template <typename T, size_t Len = 0> class Vector;
 template <typename T, size_t Len> Vector<T, Len> &
 operator+=(Vector<T, Len> &, const Vector<T, Len> &);
 template <typename T, size_t Len> Vector<T, Len> &
 operator-=(Vector<T, Len> &, const Vector<T, Len> &);
 
+// What sums of T are kept in: small integers would overflow, anything
+// else is summed as is.
+template <typename T>
+struct VectorAccumulator_ {
+  typedef T type;
+};
+
+template <> struct VectorAccumulator_<char> { typedef long long type; };
+template <> struct VectorAccumulator_<short> { typedef long long type; };
+template <> struct VectorAccumulator_<int> { typedef long long type; };
+template <> struct VectorAccumulator_<long> { typedef long long type; };
+template <> struct VectorAccumulator_<unsigned short> {
+  typedef unsigned long long type;
+};
+template <> struct VectorAccumulator_<unsigned> {
+  typedef unsigned long long type;
+};
+template <> struct VectorAccumulator_<unsigned long> {
+  typedef unsigned long long type;
+};
+
+// The kernels of the vector operations on n elements from x and y.
+// A sum is split into four independent accumulators, so that the adds
+// do not wait on each other, and the compiler never reorders a floating
+// point sum by itself. float and double have SSE2 or AVX versions.
+template <typename T>
+struct VectorKernel_ {
+  typedef typename VectorAccumulator_<T>::type Sum;
+  static Sum dot(const T *x, const T *y, size_t n) {
+    Sum s0 = Sum(0), s1 = Sum(0), s2 = Sum(0), s3 = Sum(0);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+      s0 += Sum(x[i]) * Sum(y[i]);
+      s1 += Sum(x[i + 1]) * Sum(y[i + 1]);
+      s2 += Sum(x[i + 2]) * Sum(y[i + 2]);
+      s3 += Sum(x[i + 3]) * Sum(y[i + 3]);
+    }
+    for (; i != n; ++i) s0 += Sum(x[i]) * Sum(y[i]);
+    return (s0 + s1) + (s2 + s3);
+  }
+};
+
+#if defined(__AVX__)
+template <>
+struct VectorKernel_<double> {
+  static double dot(const double *x, const double *y, size_t n) {
+    __m256d s0 = _mm256_setzero_pd(), s1 = s0, s2 = s0, s3 = s0;
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+      s0 = _mm256_add_pd(s0, _mm256_mul_pd(_mm256_loadu_pd(x + i),
+                                           _mm256_loadu_pd(y + i)));
+      s1 = _mm256_add_pd(s1, _mm256_mul_pd(_mm256_loadu_pd(x + i + 4),
+                                           _mm256_loadu_pd(y + i + 4)));
+      s2 = _mm256_add_pd(s2, _mm256_mul_pd(_mm256_loadu_pd(x + i + 8),
+                                           _mm256_loadu_pd(y + i + 8)));
+      s3 = _mm256_add_pd(s3, _mm256_mul_pd(_mm256_loadu_pd(x + i + 12),
+                                           _mm256_loadu_pd(y + i + 12)));
+    }
+    double lane[4];
+    _mm256_storeu_pd(lane, _mm256_add_pd(_mm256_add_pd(s0, s1),
+                                         _mm256_add_pd(s2, s3)));
+    double sum = (lane[0] + lane[1]) + (lane[2] + lane[3]);
+    for (; i != n; ++i) sum += x[i] * y[i];
+    return sum;
+  }
+};
+
+template <>
+struct VectorKernel_<float> {
+  static float dot(const float *x, const float *y, size_t n) {
+    __m256 s0 = _mm256_setzero_ps(), s1 = s0, s2 = s0, s3 = s0;
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+      s0 = _mm256_add_ps(s0, _mm256_mul_ps(_mm256_loadu_ps(x + i),
+                                           _mm256_loadu_ps(y + i)));
+      s1 = _mm256_add_ps(s1, _mm256_mul_ps(_mm256_loadu_ps(x + i + 8),
+                                           _mm256_loadu_ps(y + i + 8)));
+      s2 = _mm256_add_ps(s2, _mm256_mul_ps(_mm256_loadu_ps(x + i + 16),
+                                           _mm256_loadu_ps(y + i + 16)));
+      s3 = _mm256_add_ps(s3, _mm256_mul_ps(_mm256_loadu_ps(x + i + 24),
+                                           _mm256_loadu_ps(y + i + 24)));
+    }
+    float lane[8];
+    _mm256_storeu_ps(lane, _mm256_add_ps(_mm256_add_ps(s0, s1),
+                                         _mm256_add_ps(s2, s3)));
+    float sum = ((lane[0] + lane[1]) + (lane[2] + lane[3]))
+        + ((lane[4] + lane[5]) + (lane[6] + lane[7]));
+    for (; i != n; ++i) sum += x[i] * y[i];
+    return sum;
+  }
+};
+#elif defined(__SSE2__)
+template <>
+struct VectorKernel_<double> {
+  static double dot(const double *x, const double *y, size_t n) {
+    __m128d s0 = _mm_setzero_pd(), s1 = s0, s2 = s0, s3 = s0;
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+      s0 = _mm_add_pd(s0, _mm_mul_pd(_mm_loadu_pd(x + i),
+                                     _mm_loadu_pd(y + i)));
+      s1 = _mm_add_pd(s1, _mm_mul_pd(_mm_loadu_pd(x + i + 2),
+                                     _mm_loadu_pd(y + i + 2)));
+      s2 = _mm_add_pd(s2, _mm_mul_pd(_mm_loadu_pd(x + i + 4),
+                                     _mm_loadu_pd(y + i + 4)));
+      s3 = _mm_add_pd(s3, _mm_mul_pd(_mm_loadu_pd(x + i + 6),
+                                     _mm_loadu_pd(y + i + 6)));
+    }
+    double lane[2];
+    _mm_storeu_pd(lane, _mm_add_pd(_mm_add_pd(s0, s1), _mm_add_pd(s2, s3)));
+    double sum = lane[0] + lane[1];
+    for (; i != n; ++i) sum += x[i] * y[i];
+    return sum;
+  }
+};
+
+template <>
+struct VectorKernel_<float> {
+  static float dot(const float *x, const float *y, size_t n) {
+    __m128 s0 = _mm_setzero_ps(), s1 = s0, s2 = s0, s3 = s0;
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+      s0 = _mm_add_ps(s0, _mm_mul_ps(_mm_loadu_ps(x + i),
+                                     _mm_loadu_ps(y + i)));
+      s1 = _mm_add_ps(s1, _mm_mul_ps(_mm_loadu_ps(x + i + 4),
+                                     _mm_loadu_ps(y + i + 4)));
+      s2 = _mm_add_ps(s2, _mm_mul_ps(_mm_loadu_ps(x + i + 8),
+                                     _mm_loadu_ps(y + i + 8)));
+      s3 = _mm_add_ps(s3, _mm_mul_ps(_mm_loadu_ps(x + i + 12),
+                                     _mm_loadu_ps(y + i + 12)));
+    }
+    float lane[4];
+    _mm_storeu_ps(lane, _mm_add_ps(_mm_add_ps(s0, s1), _mm_add_ps(s2, s3)));
+    float sum = (lane[0] + lane[1]) + (lane[2] + lane[3]);
+    for (; i != n; ++i) sum += x[i] * y[i];
+    return sum;
+  }
+};
+#endif
+
+template <typename T> typename VectorAccumulator_<T>::type
+vectorDot_(const T *x, const T *y, size_t n) {
+  return VectorKernel_<T>::dot(x, y, n);
+}
+
+// y += a * x and x *= a. There is nothing to carry between the
+// iterations, the compiler vectorizes these by itself. a is a copy, it
+// may be an element of y or x.
+template <typename T> void
+vectorAxpy_(T a, const T *x, T *y, size_t n) {
+  for (size_t i = 0; i != n; ++i) y[i] += a * x[i];
+}
+
+template <typename T> void
+vectorScale_(T a, T *x, size_t n) {
+  for (size_t i = 0; i != n; ++i) x[i] *= a;
+}
+
+// Matrix-vector products on the row x col matrix with rows a[r], for
+// both Matrix and Matrix<T>. Only those at least this large are split
+// among the OpenMP threads, below it they do not pay for the fork.
+inline bool
+vectorParallel_(size_t work) {
+  return work >= size_t(1) << 18;
+}
+
+// y = A x, a dot product a row.
+template <typename T, typename Rows> void
+matrixVector_(const Rows &a, size_t row, size_t col, const T *x, T *y) {
+  const ptrdiff_t rows = row;
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static) if (vectorParallel_(row * col))
+#endif  // _OPENMP
+  for (ptrdiff_t r = 0; r < rows; ++r)
+    y[r] = static_cast<T>(vectorDot_(a[r], x, col));
+}
+
+// y[i] = A x[i] for i < k, a thin matrix product: a row of A is read
+// from memory once and then stays in cache for all k vectors.
+template <typename T, typename Rows> void
+matrixVectors_(const Rows &a, size_t row, size_t col,
+               const T *const *x, T *const *y, size_t k) {
+  const ptrdiff_t rows = row;
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static) if (vectorParallel_(row * col * k))
+#endif  // _OPENMP
+  for (ptrdiff_t r = 0; r < rows; ++r)
+    for (size_t i = 0; i != k; ++i)
+      y[i][r] = static_cast<T>(vectorDot_(a[r], x[i], col));
+}
+
+// sum[i * col + c] += (x[i] A)[c] over the rows [first, last) of A, as
+// sum[i] += x[i][r] * row r, so that A is read along its rows instead of
+// down its columns. The columns go in blocks, each kept in cache for all
+// those rows.
+template <typename T, typename Rows, typename Sum> void
+vectorsMatrixRows_(const T *const *x, const Rows &a, size_t first,
+                   size_t last, size_t col, size_t k, Sum *sum) {
+  const size_t block = 512;
+  for (size_t begin = 0; begin < col; begin += block) {
+    const size_t end = std::min(col, begin + block);
+    for (size_t r = first; r != last; ++r)
+      for (size_t i = 0; i != k; ++i) {
+        const Sum factor = Sum(x[i][r]);
+        const T *const from = a[r];
+        Sum *const to = sum + i * col;
+        for (size_t c = begin; c != end; ++c) to[c] += factor * Sum(from[c]);
+      }
+  }
+}
+
+// y[i] = x[i] A for i < k, summed in VectorAccumulator_ like A x. With
+// OpenMP every thread takes a range of rows into sums of its own, and
+// those are added up column by column at last. The threads are at most
+// row, so that the sums take no more memory than k copies of A.
+template <typename T, typename Rows> void
+vectorsMatrix_(const T *const *x, const Rows &a, size_t row, size_t col,
+               T *const *y, size_t k) {
+  typedef typename VectorAccumulator_<T>::type Sum;
+  const size_t size = k * col;
+  if (!size) return;
+#ifdef _OPENMP
+  const size_t threads = vectorParallel_(row * size) && !omp_in_parallel()
+      ? std::min<size_t>(omp_get_max_threads(), row) : 1;
+  if (threads > 1) {
+    std::vector<Sum> partial(threads * size, Sum(0));
+    const ptrdiff_t columns = size;
+#pragma omp parallel num_threads(threads)
+    {
+      const size_t t = omp_get_thread_num(), n = omp_get_num_threads();
+      vectorsMatrixRows_(x, a, row * t / n, row * (t + 1) / n, col, k,
+                         &partial[t * size]);
+#pragma omp barrier
+#pragma omp for schedule(static)
+      for (ptrdiff_t c = 0; c < columns; ++c) {
+        Sum sum = partial[c];
+        for (size_t j = 1; j != n; ++j) sum += partial[j * size + c];
+        y[c / col][c % col] = static_cast<T>(sum);
+      }
+    }
+    return;
+  }
+#endif  // _OPENMP
+  std::vector<Sum> sum(size, Sum(0));
+  vectorsMatrixRows_(x, a, 0, row, col, k, &sum[0]);
+  for (size_t i = 0; i != k; ++i)
+    for (size_t c = 0; c != col; ++c)
+      y[i][c] = static_cast<T>(sum[i * col + c]);
+}
+
+// y = x A, the one vector case of vectorsMatrix_.
+template <typename T, typename Rows> void
+vectorMatrix_(const T *x, const Rows &a, size_t row, size_t col, T *y) {
+  vectorsMatrix_(&x, a, row, col, &y, 1);
+}
+
 // The fix-sized vector.
 // Sometimes I thought variable-sized vector is useless.
 template <typename T, size_t Len>
@@ -23,6 +294,11 @@ class Vector {
 #if __cplusplus >= 201103L
   template <typename ...Ts>
   Vector(const Ts &...);
+  // Evaluates a + b - c in a single pass, see VectorSum below.
+  template <typename Expr, typename = typename Expr::IsVectorExpression>
+  Vector(const Expr &);
+  template <typename Expr, typename = typename Expr::IsVectorExpression>
+  Vector &operator=(const Expr &);
 #endif  // __cplusplus >= 201103L
 
   Vector &operator=(const Vector &);
@@ -57,11 +333,24 @@ Vector<T, Len>::Vector(const Ts &...t)
     : value{static_cast<T>(t)...} {
   static_assert(sizeof...(t) == Len, "Size not match");
 }
+
+template <typename T, size_t Len> template <typename Expr, typename>
+Vector<T, Len>::Vector(const Expr &expr) {
+  this->operator=(expr);
+}
+
+template <typename T, size_t Len> template <typename Expr, typename>
+Vector<T, Len> &Vector<T, Len>::operator=(const Expr &expr) {
+  static_assert(std::is_same<typename Expr::Result, Vector>::value,
+                "Type not match");
+  for (size_t i = 0; i != Len; ++i) this->value[i] = expr.at(i);
+  return *this;
+}
 #endif  // __cplusplus >= 201103L
 
 template <typename T, size_t Len> Vector<T, Len> &
 Vector<T, Len>::operator=(const Vector &that) {
-  this->copyFrom(that);
+  return this->copyFrom(that);
 }
 
 template <typename T, size_t Len> T &
@@ -98,11 +387,13 @@ operator+=(Vector<T, Len> &lhs, const Vector<T, Len> &rhs) {
   return lhs;
 }
 
+#if __cplusplus < 201103L
 template <typename T, size_t Len> Vector<T, Len>
 operator+(const Vector<T, Len> &lhs, const Vector<T, Len> &rhs) {
   Vector<T, Len> copy = lhs;
   return copy += rhs;
 }
+#endif  // __cplusplus < 201103L
 
 template <typename T, size_t Len> Vector<T, Len> &
 operator-=(Vector<T, Len> &lhs, const Vector<T, Len> &rhs) {
@@ -111,26 +402,109 @@ operator-=(Vector<T, Len> &lhs, const Vector<T, Len> &rhs) {
   return lhs;
 }
 
+#if __cplusplus < 201103L
 template <typename T, size_t Len> Vector<T, Len>
 operator-(const Vector<T, Len> &lhs, const Vector<T, Len> &rhs) {
   Vector<T, Len> copy = lhs;
   return copy -= rhs;
 }
+#else
+// Since C++11 a + b - c is lazy, the same as the Matrix expressions in
+// MatrixExpression.hh. Only element-wise nodes exist for vectors.
+template <typename T, size_t Len>
+class VectorLeaf {
+ public:
+  typedef void IsVectorExpression;
+  typedef T Value;
+  typedef Vector<T, Len> Result;
+
+  explicit VectorLeaf(const Result &vector) : vector_(vector) {}
+  const T &at(size_t i) const { return vector_[i]; }
+  size_t size() const { return vector_.size(); }
+
+ private:
+  const Result &vector_;
+};
+
+template <typename Lhs, typename Rhs, bool Subtract>
+class VectorSum {
+ public:
+  typedef void IsVectorExpression;
+  typedef typename Lhs::Value Value;
+  typedef typename Lhs::Result Result;
+
+  VectorSum(Lhs lhs, Rhs rhs) : lhs_(std::move(lhs)), rhs_(std::move(rhs)) {}
+  Value at(size_t i) const {
+    return Subtract ? lhs_.at(i) - rhs_.at(i) : lhs_.at(i) + rhs_.at(i);
+  }
+  size_t size() const { return lhs_.size(); }
+
+ private:
+  Lhs lhs_;
+  Rhs rhs_;
+};
+
+template <typename E, typename = void>
+struct VectorExpressionOf {
+};
+
+template <typename E>
+struct VectorExpressionOf<E, typename E::IsVectorExpression> {
+  typedef E type;
+  static const E &wrap(const E &expr) { return expr; }
+};
+
+template <typename T, size_t Len>
+struct VectorExpressionOf<Vector<T, Len>, void> {
+  typedef VectorLeaf<T, Len> type;
+  static type wrap(const Vector<T, Len> &vector) { return type(vector); }
+};
+
+template <typename Lhs, typename Rhs>
+VectorSum<typename VectorExpressionOf<Lhs>::type,
+          typename VectorExpressionOf<Rhs>::type, false>
+operator+(const Lhs &lhs, const Rhs &rhs) {
+  typedef typename VectorExpressionOf<Lhs>::type L;
+  typedef typename VectorExpressionOf<Rhs>::type R;
+  static_assert(std::is_same<typename L::Result, typename R::Result>::value,
+                "Type not match");
+  // Only Vector<T> can differ.
+  if (VectorExpressionOf<Lhs>::wrap(lhs).size()
+      != VectorExpressionOf<Rhs>::wrap(rhs).size())
+    throw std::invalid_argument("operator+");
+  return VectorSum<L, R, false>(VectorExpressionOf<Lhs>::wrap(lhs),
+                                VectorExpressionOf<Rhs>::wrap(rhs));
+}
+
+template <typename Lhs, typename Rhs>
+VectorSum<typename VectorExpressionOf<Lhs>::type,
+          typename VectorExpressionOf<Rhs>::type, true>
+operator-(const Lhs &lhs, const Rhs &rhs) {
+  typedef typename VectorExpressionOf<Lhs>::type L;
+  typedef typename VectorExpressionOf<Rhs>::type R;
+  static_assert(std::is_same<typename L::Result, typename R::Result>::value,
+                "Type not match");
+  // Only Vector<T> can differ.
+  if (VectorExpressionOf<Lhs>::wrap(lhs).size()
+      != VectorExpressionOf<Rhs>::wrap(rhs).size())
+    throw std::invalid_argument("operator-");
+  return VectorSum<L, R, true>(VectorExpressionOf<Lhs>::wrap(lhs),
+                               VectorExpressionOf<Rhs>::wrap(rhs));
+}
+#endif  // __cplusplus < 201103L
 
 // Inner product of two vector, see implementation below.
 // The 3-dimension vector should have cross product,
 // should I use * or something else? Missing @ in Python (>=3.5)
 template <typename T, size_t Len> T
 operator*(const Vector<T, Len> &lhs, const Vector<T, Len> &rhs) {
-  return std::inner_product(&lhs[0], &lhs[0] + Len, &rhs[0], 0);
+  return static_cast<T>(vectorDot_(&lhs[0], &rhs[0], Len));
 }
 
-template <typename T, size_t Len> Vector<T, Len>
-operator*(const Vector<T, Len> &lhs, const Matrix<T, Len, Len> &rhs) {
-  Vector<T, Len> result;
-  for (size_t i = 0; i != Len; ++i)
-    for (size_t j = 0; j != Len; ++j)
-      result[i] += lhs[j] * rhs[j][i];
+template <typename T, size_t Row, size_t Col> Vector<T, Col>
+operator*(const Vector<T, Row> &lhs, const Matrix<T, Row, Col> &rhs) {
+  Vector<T, Col> result;
+  vectorMatrix_(&lhs[0], rhs, Row, Col, &result[0]);
   return result;
 }
 
@@ -139,12 +513,10 @@ operator*=(Vector<T, Len> &lhs, const Matrix<T, Len, Len> &rhs) {
   return lhs = lhs * rhs;
 }
 
-template <typename T, size_t Len> Vector<T, Len>
-operator*(const Matrix<T, Len, Len> &lhs, const Vector<T, Len> &rhs) {
-  Vector<T, Len> result;
-  for (size_t i = 0; i != Len; ++i)
-    for (size_t j = 0; j != Len; ++j)
-      result[i] += lhs[i][j] * rhs[j];
+template <typename T, size_t Row, size_t Col> Vector<T, Row>
+operator*(const Matrix<T, Row, Col> &lhs, const Vector<T, Col> &rhs) {
+  Vector<T, Row> result;
+  matrixVector_(lhs, Row, Col, &rhs[0], &result[0]);
   return result;
 }
 
@@ -157,3 +529,226 @@ template <typename T, size_t Len> bool
 operator!=(const Vector<T, Len> &lhs, const Vector<T, Len> &rhs) {
   return !(lhs == rhs);
 }
+
+// Vector<T> is sized at runtime, for the solvers (see IterativeSolver.hh)
+// where the length is only known from the input. The operators between
+// two of them, or with a Matrix<T>, throw std::invalid_argument if the
+// sizes do not match.
+template <typename T>
+class Vector<T, 0> {
+ public:
+  Vector();
+  explicit Vector(size_t);
+  Vector(size_t, const T &);
+  explicit Vector(const std::vector<T> &);
+#if __cplusplus >= 201103L
+  template <typename Expr, typename = typename Expr::IsVectorExpression>
+  Vector(const Expr &);
+  template <typename Expr, typename = typename Expr::IsVectorExpression>
+  Vector &operator=(const Expr &);
+#endif  // __cplusplus >= 201103L
+
+  T &operator[](size_t);
+  const T &operator[](size_t) const;
+
+  // NULL if empty.
+  T *data();
+  const T *data() const;
+  size_t size() const;
+  void resize(size_t);
+
+ private:
+  std::vector<T> value;
+};
+
+template <typename T>
+Vector<T, 0>::Vector() {}
+
+template <typename T>
+Vector<T, 0>::Vector(size_t len) : value(len, T(0)) {}
+
+template <typename T>
+Vector<T, 0>::Vector(size_t len, const T &fill) : value(len, fill) {}
+
+template <typename T>
+Vector<T, 0>::Vector(const std::vector<T> &that) : value(that) {}
+
+#if __cplusplus >= 201103L
+template <typename T> template <typename Expr, typename>
+Vector<T, 0>::Vector(const Expr &expr) {
+  this->operator=(expr);
+}
+
+template <typename T> template <typename Expr, typename>
+Vector<T, 0> &Vector<T, 0>::operator=(const Expr &expr) {
+  static_assert(std::is_same<typename Expr::Result, Vector>::value,
+                "Type not match");
+  // An operand of expr is already of its size, so it stays in place.
+  this->value.resize(expr.size());
+  for (size_t i = 0; i != this->value.size(); ++i) this->value[i] = expr.at(i);
+  return *this;
+}
+#endif  // __cplusplus >= 201103L
+
+template <typename T> T &
+Vector<T, 0>::operator[](size_t index) {
+  return this->value[index];
+}
+
+template <typename T> const T &
+Vector<T, 0>::operator[](size_t index) const {
+  return this->value[index];
+}
+
+template <typename T> T *
+Vector<T, 0>::data() {
+  return this->value.empty() ? NULL : &this->value[0];
+}
+
+template <typename T> const T *
+Vector<T, 0>::data() const {
+  return this->value.empty() ? NULL : &this->value[0];
+}
+
+template <typename T> size_t
+Vector<T, 0>::size() const {
+  return this->value.size();
+}
+
+template <typename T> void
+Vector<T, 0>::resize(size_t len) {
+  this->value.resize(len, T(0));
+}
+
+// The sum is kept in VectorAccumulator_<T>::type, e.g. long long for int.
+template <typename T> typename VectorAccumulator_<T>::type
+dot(const Vector<T> &x, const Vector<T> &y) {
+  if (x.size() != y.size()) throw std::invalid_argument("dot");
+  return vectorDot_(x.data(), y.data(), x.size());
+}
+
+// y += a * x.
+template <typename T> Vector<T> &
+axpy(T a, const Vector<T> &x, Vector<T> &y) {
+  if (x.size() != y.size()) throw std::invalid_argument("axpy");
+  vectorAxpy_(a, x.data(), y.data(), x.size());
+  return y;
+}
+
+// x *= a.
+template <typename T> Vector<T> &
+scale(T a, Vector<T> &x) {
+  vectorScale_(a, x.data(), x.size());
+  return x;
+}
+
+// The Euclidean norm, for floating-point T.
+template <typename T> T
+norm(const Vector<T> &x) {
+  using std::sqrt;
+  return sqrt(static_cast<T>(vectorDot_(x.data(), x.data(), x.size())));
+}
+
+// The overloads below are more specialized than those with Len, so they
+// are taken for Vector<T>.
+template <typename T> Vector<T> &
+operator+=(Vector<T> &lhs, const Vector<T> &rhs) {
+  if (lhs.size() != rhs.size()) throw std::invalid_argument("operator+=");
+  T *const x = lhs.data();
+  const T *const y = rhs.data();
+  for (size_t i = 0; i != lhs.size(); ++i) x[i] += y[i];
+  return lhs;
+}
+
+template <typename T> Vector<T> &
+operator-=(Vector<T> &lhs, const Vector<T> &rhs) {
+  if (lhs.size() != rhs.size()) throw std::invalid_argument("operator-=");
+  T *const x = lhs.data();
+  const T *const y = rhs.data();
+  for (size_t i = 0; i != lhs.size(); ++i) x[i] -= y[i];
+  return lhs;
+}
+
+#if __cplusplus < 201103L
+template <typename T> Vector<T>
+operator+(const Vector<T> &lhs, const Vector<T> &rhs) {
+  Vector<T> copy = lhs;
+  return copy += rhs;
+}
+
+template <typename T> Vector<T>
+operator-(const Vector<T> &lhs, const Vector<T> &rhs) {
+  Vector<T> copy = lhs;
+  return copy -= rhs;
+}
+#endif  // __cplusplus < 201103L
+
+template <typename T> T
+operator*(const Vector<T> &lhs, const Vector<T> &rhs) {
+  return static_cast<T>(dot(lhs, rhs));
+}
+
+template <typename T> Vector<T>
+operator*(const Matrix<T> &lhs, const Vector<T> &rhs) {
+  if (lhs.col() != rhs.size()) throw std::invalid_argument("operator*");
+  Vector<T> result(lhs.row());
+  matrixVector_(lhs, lhs.row(), lhs.col(), rhs.data(), result.data());
+  return result;
+}
+
+template <typename T> Vector<T>
+operator*(const Vector<T> &lhs, const Matrix<T> &rhs) {
+  if (lhs.size() != rhs.row()) throw std::invalid_argument("operator*");
+  Vector<T> result(rhs.col());
+  vectorMatrix_(lhs.data(), rhs, rhs.row(), rhs.col(), result.data());
+  return result;
+}
+
+// A x for every x of xs at once, faster than one by one since A is read
+// once, e.g. for block power iteration.
+template <typename T> std::vector<Vector<T> >
+multiplyBatch(const Matrix<T> &matrix, const std::vector<Vector<T> > &xs) {
+  const size_t k = xs.size();
+  std::vector<Vector<T> > ys(k, Vector<T>(matrix.row()));
+  std::vector<const T *> x(k + 1);
+  std::vector<T *> y(k + 1);
+  for (size_t i = 0; i != k; ++i) {
+    if (xs[i].size() != matrix.col())
+      throw std::invalid_argument("multiplyBatch");
+    x[i] = xs[i].data(), y[i] = ys[i].data();
+  }
+  matrixVectors_(matrix, matrix.row(), matrix.col(), &x[0], &y[0], k);
+  return ys;
+}
+
+// x A for every x of xs, e.g. a few distributions of a Markov chain.
+template <typename T> std::vector<Vector<T> >
+multiplyBatch(const std::vector<Vector<T> > &xs, const Matrix<T> &matrix) {
+  const size_t k = xs.size();
+  std::vector<Vector<T> > ys(k, Vector<T>(matrix.col()));
+  std::vector<const T *> x(k + 1);
+  std::vector<T *> y(k + 1);
+  for (size_t i = 0; i != k; ++i) {
+    if (xs[i].size() != matrix.row())
+      throw std::invalid_argument("multiplyBatch");
+    x[i] = xs[i].data(), y[i] = ys[i].data();
+  }
+  vectorsMatrix_(&x[0], matrix, matrix.row(), matrix.col(), &y[0], k);
+  return ys;
+}
+
+template <typename T> Vector<T> &
+operator*=(Vector<T> &lhs, const Matrix<T> &rhs) {
+  return lhs = lhs * rhs;
+}
+
+template <typename T> bool
+operator==(const Vector<T> &lhs, const Vector<T> &rhs) {
+  return lhs.size() == rhs.size()
+      && std::equal(lhs.data(), lhs.data() + lhs.size(), rhs.data());
+}
+
+template <typename T> bool
+operator!=(const Vector<T> &lhs, const Vector<T> &rhs) {
+  return !(lhs == rhs);
+}
@@ -0,0 +1,216 @@
+#pragma once
+
+#include <stdexcept>
+#include <vector>
+
+#include "SparseMatrix.hh"
+#include "../NumberTheory/Residue.hh"
+
+// Black-box linear algebra over Z/pZ for huge sparse matrices, where the
+// elimination of SparseMatrix fills in. Everything below only multiplies
+// the matrix by vectors: 2n products for the minimal polynomial of the
+// sequence u A^i v (Berlekamp-Massey), so O(n nnz) time and O(n) memory.
+// They are Monte Carlo with random projections, and assume Mod is a prime
+// much larger than n. The products run in parallel with OpenMP, see
+// SparseMatrix::multiply and multiplyTransposed.
+
+// The shortest linear recurrence of s over a field, as the connection
+// polynomial c with c[0] = 1, i.e. sum c[j] s[i - j] = 0 for all i >= L,
+// where L = c.size() - 1.
+template <typename T> std::vector<T>
+berlekampMassey(const std::vector<T> &s) {
+  std::vector<T> c(1, T(1)), b(1, T(1)), t;
+  size_t length = 0, shift = 1;
+  T last = T(1);
+  for (size_t n = 0; n != s.size(); ++n, ++shift) {
+    T d = s[n];
+    for (size_t i = 1; i <= length; ++i) d += c[i] * s[n - i];
+    if (isZero(d)) continue;
+    const T f = d / last;
+    const bool grows = 2 * length <= n;
+    if (grows) t = c;
+    if (c.size() < b.size() + shift) c.resize(b.size() + shift, T(0));
+    for (size_t i = 0; i != b.size(); ++i) c[i + shift] -= f * b[i];
+    if (!grows) continue;
+    length = n + 1 - length;
+    b.swap(t);
+    last = d;
+    shift = 0;
+  }
+  c.resize(length + 1);
+  return c;
+}
+
+// xorshift64*, enough to pick the random projections.
+inline unsigned long long
+wiedemannRandom_(unsigned long long &state) {
+  state ^= state >> 12;
+  state ^= state << 25;
+  state ^= state >> 27;
+  return state * 2685821657736338717ULL;
+}
+
+template <typename T, T Mod> Residue<T, Mod>
+wiedemannNonZero_(unsigned long long &state) {
+  for (;;) {
+    const Residue<T, Mod> x(static_cast<T>(wiedemannRandom_(state) % Mod));
+    if (!isZero(x)) return x;
+  }
+}
+
+// The connection polynomial of u . M^i v for i < 2n, where M x is
+// computed by apply(x, y) writing M x to y.
+template <typename T, typename Apply> std::vector<T>
+wiedemannSequence_(const std::vector<T> &u, const std::vector<T> &v,
+                   Apply &apply) {
+  const size_t n = u.size();
+  std::vector<T> s(2 * n), x(v), y(n);
+  for (size_t i = 0; i != 2 * n; ++i) {
+    T dot = T(0);
+    for (size_t j = 0; j != n; ++j) dot += u[j] * x[j];
+    s[i] = dot;
+    if (i + 1 != 2 * n) apply(x, y), x.swap(y);
+  }
+  return berlekampMassey(s);
+}
+
+// x -> A x.
+template <typename T>
+struct WiedemannProduct_ {
+  const SparseMatrix<T> &matrix;
+
+  explicit WiedemannProduct_(const SparseMatrix<T> &matrix)
+      : matrix(matrix) {}
+  void operator()(const std::vector<T> &x, std::vector<T> &y) {
+    this->matrix.multiply(&x[0], &y[0]);
+  }
+};
+
+// x -> A D x, with D = diag(d).
+template <typename T>
+struct WiedemannScaled_ {
+  const SparseMatrix<T> &matrix;
+  const std::vector<T> &d;
+  std::vector<T> t;
+
+  WiedemannScaled_(const SparseMatrix<T> &matrix, const std::vector<T> &d)
+      : matrix(matrix), d(d), t(d.size()) {}
+  void operator()(const std::vector<T> &x, std::vector<T> &y) {
+    for (size_t i = 0; i != x.size(); ++i) t[i] = d[i] * x[i];
+    this->matrix.multiply(&t[0], &y[0]);
+  }
+};
+
+// x -> D1 A^T D2 A D1 x, which is symmetric and, for random D1 and D2,
+// has the rank of A as the degree of its minimal polynomial (less one if
+// singular).
+template <typename T>
+struct WiedemannSymmetric_ {
+  const SparseMatrix<T> &matrix;
+  const std::vector<T> &d1, &d2;
+  std::vector<T> s, t;
+
+  WiedemannSymmetric_(const SparseMatrix<T> &matrix,
+                      const std::vector<T> &d1, const std::vector<T> &d2)
+      : matrix(matrix), d1(d1), d2(d2), s(d1.size()), t(d2.size()) {}
+  void operator()(const std::vector<T> &x, std::vector<T> &y) {
+    for (size_t i = 0; i != x.size(); ++i) s[i] = d1[i] * x[i];
+    if (!t.empty()) this->matrix.multiply(&s[0], &t[0]);
+    for (size_t i = 0; i != t.size(); ++i) t[i] *= d2[i];
+    if (!t.empty()) this->matrix.multiplyTransposed(&t[0], &y[0]);
+    else std::fill(y.begin(), y.end(), T(0));
+    for (size_t i = 0; i != y.size(); ++i) y[i] *= d1[i];
+  }
+};
+
+// Solves A x = b for a square A, with f(A) b = 0 where f is the minimal
+// polynomial of b: x = -(f_1 b + f_2 A b + ...) / f_0. x is checked
+// before returning true. That always works for a nonsingular A (but for
+// bad luck), and may for a singular one, e.g. if b = 0.
+// Throws std::invalid_argument if not square.
+template <typename T, T Mod> bool
+wiedemannSolve(const SparseMatrix<Residue<T, Mod> > &matrix,
+               const Residue<T, Mod> *b, Residue<T, Mod> *x,
+               unsigned long long seed = 88172645463325252ULL) {
+  typedef Residue<T, Mod> R;
+  const size_t n = matrix.row();
+  if (n != matrix.col()) throw std::invalid_argument("wiedemannSolve");
+  if (!n) return true;
+  const std::vector<R> v(b, b + n);
+  std::vector<R> u(n), y(n), z(n);
+  WiedemannProduct_<R> apply(matrix);
+  for (int tries = 0; tries != 4; ++tries) {
+    for (size_t i = 0; i != n; ++i) u[i] = wiedemannNonZero_<T, Mod>(seed);
+    const std::vector<R> c = wiedemannSequence_(u, v, apply);
+    // f_k = c[L - k], so f_0 = c[L].
+    const size_t length = c.size() - 1;
+    if (isZero(c[length])) return false;
+    std::vector<R> w(v), sum(n, R(0));
+    for (size_t k = 1; k <= length; ++k) {
+      for (size_t i = 0; i != n; ++i) sum[i] += c[length - k] * w[i];
+      if (k != length) apply(w, y), w.swap(y);
+    }
+    const R f = R(0) - R(1) / c[length];
+    for (size_t i = 0; i != n; ++i) x[i] = sum[i] * f;
+    matrix.multiply(x, &z[0]);
+    bool solved = true;
+    for (size_t i = 0; solved && i != n; ++i) solved = z[i] == b[i];
+    if (solved) return true;
+  }
+  return false;
+}
+
+// det(A D) = (-1)^n f_0 once the minimal polynomial f of A D is of degree
+// n, which a random diagonal D makes likely. A zero f_0 proves A singular.
+// Throws std::invalid_argument if not square, or if every try was unlucky.
+template <typename T, T Mod> Residue<T, Mod>
+wiedemannDeterminant(const SparseMatrix<Residue<T, Mod> > &matrix,
+                     unsigned long long seed = 88172645463325252ULL) {
+  typedef Residue<T, Mod> R;
+  const size_t n = matrix.row();
+  if (n != matrix.col()) throw std::invalid_argument("wiedemannDeterminant");
+  if (!n) return R(1);
+  std::vector<R> u(n), v(n), d(n);
+  WiedemannScaled_<R> apply(matrix, d);
+  for (int tries = 0; tries != 4; ++tries) {
+    for (size_t i = 0; i != n; ++i) {
+      u[i] = wiedemannNonZero_<T, Mod>(seed);
+      v[i] = wiedemannNonZero_<T, Mod>(seed);
+      d[i] = wiedemannNonZero_<T, Mod>(seed);
+    }
+    const std::vector<R> c = wiedemannSequence_(u, v, apply);
+    const size_t length = c.size() - 1;
+    if (isZero(c[length])) return R(0);
+    if (length != n) continue;
+    R result = n % 2 ? R(0) - c[length] : c[length];
+    for (size_t i = 0; i != n; ++i) result /= d[i];
+    return result;
+  }
+  throw std::invalid_argument("wiedemannDeterminant");
+}
+
+// The rank of any A from the minimal polynomial of D1 A^T D2 A D1, the
+// largest of a few tries since an unlucky one can only come out lower.
+template <typename T, T Mod> size_t
+wiedemannRank(const SparseMatrix<Residue<T, Mod> > &matrix,
+              unsigned long long seed = 88172645463325252ULL) {
+  typedef Residue<T, Mod> R;
+  const size_t n = matrix.col(), m = matrix.row();
+  if (!n || !m) return 0;
+  std::vector<R> u(n), v(n), d1(n), d2(m);
+  WiedemannSymmetric_<R> apply(matrix, d1, d2);
+  size_t rank = 0;
+  for (int tries = 0; tries != 2; ++tries) {
+    for (size_t i = 0; i != n; ++i) {
+      u[i] = wiedemannNonZero_<T, Mod>(seed);
+      v[i] = wiedemannNonZero_<T, Mod>(seed);
+      d1[i] = wiedemannNonZero_<T, Mod>(seed);
+    }
+    for (size_t i = 0; i != m; ++i) d2[i] = wiedemannNonZero_<T, Mod>(seed);
+    const std::vector<R> c = wiedemannSequence_(u, v, apply);
+    const size_t length = c.size() - 1;
+    const size_t found = length - (isZero(c[length]) && length ? 1 : 0);
+    if (found > rank) rank = found;
+  }
+  return rank;
+}
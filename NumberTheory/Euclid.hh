@@ -1,3 +1,5 @@
+#pragma once
+
 #include <algorithm>  // std::swap
 #include <utility>  // std::pair, std::make_pair
 
@@ -0,0 +1,432 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>  // size_t
+#include <iterator>  // std::reverse_iterator
+#include <stdexcept>
+// cstdint is a C++11 header.
+#include <stdint.h>
+#include <vector>
+
+#include "Residue.hh"
+#include "ResidueArray.hh"
+
+// Number theoretic transforms (NTT) modulo a prime P below 2^32, over
+// Residue<uint32_t, P> in Montgomery form, for the convolutions of
+// Polynomial, BigInteger and the like:
+//   typedef NTT<998244353> Engine;
+//   std::vector<Engine::Value> a(n), b(m), c(n + m - 1);
+//   Engine::convolve(&a[0], n, &b[0], m, &c[0]);
+// The transforms are radix 4, with one radix 2 level for an odd log of
+// the length. The forward one decimates in frequency and leaves the
+// bit-reversed order, which the inverse one, in time, takes back, so
+// neither reorders. The roots come from a few per level, found once for
+// every P, and the butterflies run in ResidueLanes_ where those fit.
+// A product a little longer than a power of 2 wraps around in a transform
+// of that, and the wrapped top terms come from a short product of the
+// reversed tops, instead of a transform twice as long. middleProduct
+// wraps around likewise for the terms it leaves out.
+
+// a^expo modulo mod below 2^32.
+inline uint64_t
+nttModPower_(uint64_t a, uint64_t expo, uint64_t mod) {
+  uint64_t result = 1 % mod;
+  for (a %= mod; expo; expo >>= 1, a = a * a % mod)
+    if (expo & 1) result = result * a % mod;
+  return result;
+}
+
+// A primitive root modulo p, or 0 if p is not a prime. Trial division is
+// quick enough below 2^32, and it is only done once for every p.
+inline uint32_t
+nttPrimitiveRoot_(uint32_t p) {
+  if (p < 3) return p == 2 ? 1 : 0;
+  for (uint32_t d = 2; uint64_t(d) * d <= p; ++d)
+    if (p % d == 0) return 0;
+  uint32_t factors[32], m = p - 1;
+  size_t count = 0;
+  for (uint32_t d = 2; uint64_t(d) * d <= m; ++d)
+    if (m % d == 0) {
+      factors[count++] = d;
+      while (m % d == 0) m /= d;
+    }
+  if (m > 1) factors[count++] = m;
+  for (uint32_t g = 2; ; ++g) {
+    bool primitive = true;
+    for (size_t i = 0; i != count && primitive; ++i)
+      primitive = nttModPower_(g, (p - 1) / factors[i], p) != 1;
+    if (primitive) return g;
+  }
+}
+
+// The number of trailing ones of s, which picks the root of the next block.
+inline int
+nttTrailingOnes_(size_t s) {
+#if defined(__GNUC__)
+  return __builtin_ctzll(~static_cast<unsigned long long>(s));
+#else
+  int result = 0;
+  for (; s & 1; s >>= 1) ++result;
+  return result;
+#endif
+}
+
+// 2^rank | P - 1 (rank is 0 if P is not a prime). Block s of a level is
+// twisted by the root of the one before times rate[trailing ones of s - 1],
+// rate2 for the radix 2 levels and rate3 for the radix 4 ones; imag is the
+// 4th root of unity, and the i ones are the inverses.
+template <uint32_t P>
+struct NTTRoots_ {
+  typedef Residue<uint32_t, P> Z;
+
+  int rank;
+  Z imag, iimag;
+  Z rate2[32], irate2[32], rate3[32], irate3[32];
+
+  NTTRoots_() : rank(0) {
+    const uint32_t g = nttPrimitiveRoot_(P);
+    if (!g) return;
+    while (this->rank < 31 && !((P - 1) >> this->rank & 1)) ++this->rank;
+    const Z one(1u);
+    // root[i] is a primitive 2^i-th root of unity.
+    Z root[32], iroot[32];
+    root[this->rank] = Z(static_cast<uint32_t>(
+        nttModPower_(g, (P - 1) >> this->rank, P)));
+    iroot[this->rank] = one / root[this->rank];
+    for (int i = this->rank; i--; ) {
+      root[i] = root[i + 1] * root[i + 1];
+      iroot[i] = iroot[i + 1] * iroot[i + 1];
+    }
+    this->imag = this->rank >= 2 ? root[2] : one;
+    this->iimag = this->rank >= 2 ? iroot[2] : one;
+    Z product = one, iproduct = one;
+    for (int i = 0; i + 2 <= this->rank; ++i) {
+      this->rate2[i] = root[i + 2] * product;
+      this->irate2[i] = iroot[i + 2] * iproduct;
+      product *= iroot[i + 2];
+      iproduct *= root[i + 2];
+    }
+    product = iproduct = one;
+    for (int i = 0; i + 3 <= this->rank; ++i) {
+      this->rate3[i] = root[i + 3] * product;
+      this->irate3[i] = iroot[i + 3] * iproduct;
+      product *= iroot[i + 3];
+      iproduct *= root[i + 3];
+    }
+  }
+};
+
+// The butterflies of a block: a[i + k p] for k in [0, 4) (or [0, 2)) and
+// i in [begin, p), with the roots of the block.
+template <uint32_t P, bool = ResidueLanesFit_<uint32_t, P>::value>
+struct NTTKernel_ {
+  typedef Residue<uint32_t, P> Z;
+
+  static void forward2(Z *a, size_t begin, size_t p, const Z &rot) {
+    for (size_t i = begin; i != p; ++i) {
+      const Z l = a[i], r = a[i + p] * rot;
+      a[i] = l + r;
+      a[i + p] = l - r;
+    }
+  }
+  static void forward4(Z *a, size_t begin, size_t p, const Z &rot,
+                       const Z &rot2, const Z &rot3, const Z &imag) {
+    for (size_t i = begin; i != p; ++i) {
+      const Z a0 = a[i], a1 = a[i + p] * rot;
+      const Z a2 = a[i + p * 2] * rot2, a3 = a[i + p * 3] * rot3;
+      const Z t = (a1 - a3) * imag, s02 = a0 + a2, d02 = a0 - a2;
+      const Z s13 = a1 + a3;
+      a[i] = s02 + s13;
+      a[i + p] = s02 - s13;
+      a[i + p * 2] = d02 + t;
+      a[i + p * 3] = d02 - t;
+    }
+  }
+  static void inverse2(Z *a, size_t begin, size_t p, const Z &irot) {
+    for (size_t i = begin; i != p; ++i) {
+      const Z l = a[i], r = a[i + p];
+      a[i] = l + r;
+      a[i + p] = (l - r) * irot;
+    }
+  }
+  static void inverse4(Z *a, size_t begin, size_t p, const Z &irot,
+                       const Z &irot2, const Z &irot3, const Z &iimag) {
+    for (size_t i = begin; i != p; ++i) {
+      const Z a0 = a[i], a1 = a[i + p], a2 = a[i + p * 2], a3 = a[i + p * 3];
+      const Z t = (a2 - a3) * iimag, s01 = a0 + a1, d01 = a0 - a1;
+      const Z s23 = a2 + a3;
+      a[i] = s01 + s23;
+      a[i + p] = (d01 + t) * irot;
+      a[i + p * 2] = (s01 - s23) * irot2;
+      a[i + p * 3] = (d01 - t) * irot3;
+    }
+  }
+};
+
+#if defined(__AVX2__) || defined(__AVX512F__)
+template <uint32_t P>
+struct NTTKernel_<P, true> {
+  typedef Residue<uint32_t, P> Z;
+  typedef NTTKernel_<P, false> Scalar;
+  typedef ResidueArray_<uint32_t, P> Array;
+  typedef ResidueLanes_ Lanes;
+  typedef Lanes::Word Word;
+
+  static Word mod() { return Lanes::broadcast(P); }
+  static Word inverse() {
+    return Lanes::broadcast(ResidueForm_<uint32_t, P>::inverse);
+  }
+  static Word multiply(Word x, Word y) {
+    return Lanes::multiply(x, y, mod(), inverse());
+  }
+
+  static void forward2(Z *a, size_t begin, size_t p, const Z &rot) {
+    const Word m = mod(), r = Lanes::broadcast(Array::raw(rot));
+    size_t i = begin;
+    for (; i + Lanes::size <= p; i += Lanes::size) {
+      const Word l = Lanes::load(a + i);
+      const Word s = multiply(Lanes::load(a + i + p), r);
+      Lanes::store(a + i, Lanes::add(l, s, m));
+      Lanes::store(a + i + p, Lanes::subtract(l, s, m));
+    }
+    Scalar::forward2(a, i, p, rot);
+  }
+  static void forward4(Z *a, size_t begin, size_t p, const Z &rot,
+                       const Z &rot2, const Z &rot3, const Z &imag) {
+    const Word m = mod(), r1 = Lanes::broadcast(Array::raw(rot));
+    const Word r2 = Lanes::broadcast(Array::raw(rot2));
+    const Word r3 = Lanes::broadcast(Array::raw(rot3));
+    const Word im = Lanes::broadcast(Array::raw(imag));
+    size_t i = begin;
+    for (; i + Lanes::size <= p; i += Lanes::size) {
+      const Word a0 = Lanes::load(a + i);
+      const Word a1 = multiply(Lanes::load(a + i + p), r1);
+      const Word a2 = multiply(Lanes::load(a + i + p * 2), r2);
+      const Word a3 = multiply(Lanes::load(a + i + p * 3), r3);
+      const Word t = multiply(Lanes::subtract(a1, a3, m), im);
+      const Word s02 = Lanes::add(a0, a2, m), d02 = Lanes::subtract(a0, a2, m);
+      const Word s13 = Lanes::add(a1, a3, m);
+      Lanes::store(a + i, Lanes::add(s02, s13, m));
+      Lanes::store(a + i + p, Lanes::subtract(s02, s13, m));
+      Lanes::store(a + i + p * 2, Lanes::add(d02, t, m));
+      Lanes::store(a + i + p * 3, Lanes::subtract(d02, t, m));
+    }
+    Scalar::forward4(a, i, p, rot, rot2, rot3, imag);
+  }
+  static void inverse2(Z *a, size_t begin, size_t p, const Z &irot) {
+    const Word m = mod(), r = Lanes::broadcast(Array::raw(irot));
+    size_t i = begin;
+    for (; i + Lanes::size <= p; i += Lanes::size) {
+      const Word l = Lanes::load(a + i), s = Lanes::load(a + i + p);
+      Lanes::store(a + i, Lanes::add(l, s, m));
+      Lanes::store(a + i + p, multiply(Lanes::subtract(l, s, m), r));
+    }
+    Scalar::inverse2(a, i, p, irot);
+  }
+  static void inverse4(Z *a, size_t begin, size_t p, const Z &irot,
+                       const Z &irot2, const Z &irot3, const Z &iimag) {
+    const Word m = mod(), r1 = Lanes::broadcast(Array::raw(irot));
+    const Word r2 = Lanes::broadcast(Array::raw(irot2));
+    const Word r3 = Lanes::broadcast(Array::raw(irot3));
+    const Word im = Lanes::broadcast(Array::raw(iimag));
+    size_t i = begin;
+    for (; i + Lanes::size <= p; i += Lanes::size) {
+      const Word a0 = Lanes::load(a + i), a1 = Lanes::load(a + i + p);
+      const Word a2 = Lanes::load(a + i + p * 2);
+      const Word a3 = Lanes::load(a + i + p * 3);
+      const Word t = multiply(Lanes::subtract(a2, a3, m), im);
+      const Word s01 = Lanes::add(a0, a1, m), d01 = Lanes::subtract(a0, a1, m);
+      const Word s23 = Lanes::add(a2, a3, m);
+      Lanes::store(a + i, Lanes::add(s01, s23, m));
+      Lanes::store(a + i + p, multiply(Lanes::add(d01, t, m), r1));
+      Lanes::store(a + i + p * 2, multiply(Lanes::subtract(s01, s23, m), r2));
+      Lanes::store(a + i + p * 3, multiply(Lanes::subtract(d01, t, m), r3));
+    }
+    Scalar::inverse4(a, i, p, irot, irot2, irot3, iimag);
+  }
+};
+#endif  // defined(__AVX2__) || defined(__AVX512F__)
+
+template <uint32_t P>
+class NTT {
+ public:
+  typedef Residue<uint32_t, P> Value;
+
+  // The longest transform, the 2^k with 2^k | P - 1, or 0 if P is not a
+  // prime.
+  static size_t maxLength();
+  // The shortest transform of size terms, a power of 2.
+  static size_t length(size_t size);
+  static bool fits(size_t len);
+
+  // a[0, len) in place, for a power of 2 len up to maxLength(). forward
+  // leaves the bit-reversed order that inverse takes; inverse divides by
+  // len too.
+  static void forward(Value *a, size_t len);
+  static void inverse(Value *a, size_t len);
+
+  // c[0, n + m - 1) = a[0, n) * b[0, m).
+  static void convolve(const Value *a, size_t n, const Value *b, size_t m,
+                       Value *c);
+  // c[0, hi - lo) = (a[0, n) * b[0, m))[lo, hi), in a transform of just
+  // max(hi, n + m - 1 - lo) terms: the terms that wrap around stay below
+  // lo, e.g. for the Newton's iterations of inverses.
+  // c must not overlap a or b. Both throw std::invalid_argument if the
+  // transform needed is longer than maxLength().
+  static void middleProduct(const Value *a, size_t n,
+                            const Value *b, size_t m,
+                            size_t lo, size_t hi, Value *c);
+
+ private:
+  typedef NTTKernel_<P> Kernel_;
+
+  static const NTTRoots_<P> &roots_();
+  // a * b mod x^len - 1 into c.
+  static void cyclic_(const Value *a, size_t n, const Value *b, size_t m,
+                      size_t len, std::vector<Value> &c);
+};
+
+template <uint32_t P> const NTTRoots_<P> &
+NTT<P>::roots_() {
+  static const NTTRoots_<P> roots;
+  return roots;
+}
+
+template <uint32_t P> size_t
+NTT<P>::maxLength() {
+  const NTTRoots_<P> &roots = roots_();
+  return roots.rank || P == 2 ? size_t(1) << roots.rank : 0;
+}
+
+template <uint32_t P> size_t
+NTT<P>::length(size_t size) {
+  size_t len = 1;
+  while (len < size) len <<= 1;
+  return len;
+}
+
+template <uint32_t P> bool
+NTT<P>::fits(size_t len) {
+  return len <= maxLength();
+}
+
+template <uint32_t P> void
+NTT<P>::forward(Value *a, size_t len) {
+  const NTTRoots_<P> &roots = roots_();
+  int h = 0;
+  while (size_t(1) << h < len) ++h;
+  for (int level = 0; level < h; ) {
+    const size_t blocks = size_t(1) << level;
+    Value rot(1u);
+    if (h - level == 1) {
+      const size_t p = size_t(1) << (h - level - 1);
+      for (size_t s = 0; s != blocks; ++s) {
+        Kernel_::forward2(a + (s << (h - level)), 0, p, rot);
+        if (s + 1 != blocks) rot *= roots.rate2[nttTrailingOnes_(s)];
+      }
+      ++level;
+    } else {
+      const size_t p = size_t(1) << (h - level - 2);
+      for (size_t s = 0; s != blocks; ++s) {
+        const Value rot2 = rot * rot, rot3 = rot2 * rot;
+        Kernel_::forward4(a + (s << (h - level)), 0, p, rot, rot2, rot3,
+                          roots.imag);
+        if (s + 1 != blocks) rot *= roots.rate3[nttTrailingOnes_(s)];
+      }
+      level += 2;
+    }
+  }
+}
+
+template <uint32_t P> void
+NTT<P>::inverse(Value *a, size_t len) {
+  const NTTRoots_<P> &roots = roots_();
+  int h = 0;
+  while (size_t(1) << h < len) ++h;
+  for (int level = h; level; ) {
+    Value irot(1u);
+    const size_t p = size_t(1) << (h - level);
+    if (level == 1) {
+      for (size_t s = 0, blocks = size_t(1) << (level - 1); s != blocks; ++s) {
+        Kernel_::inverse2(a + (s << (h - level + 1)), 0, p, irot);
+        if (s + 1 != blocks) irot *= roots.irate2[nttTrailingOnes_(s)];
+      }
+      --level;
+    } else {
+      for (size_t s = 0, blocks = size_t(1) << (level - 2); s != blocks; ++s) {
+        const Value irot2 = irot * irot, irot3 = irot2 * irot;
+        Kernel_::inverse4(a + (s << (h - level + 2)), 0, p, irot, irot2, irot3,
+                          roots.iimag);
+        if (s + 1 != blocks) irot *= roots.irate3[nttTrailingOnes_(s)];
+      }
+      level -= 2;
+    }
+  }
+  const Value one(1u);
+  scaleEach(one / Value(static_cast<uint32_t>(len)), a, a, len);
+}
+
+template <uint32_t P> void
+NTT<P>::cyclic_(const Value *a, size_t n, const Value *b, size_t m,
+                size_t len, std::vector<Value> &c) {
+  if (len > maxLength()) throw std::invalid_argument("NTT");
+  c.assign(len, Value());
+  for (size_t i = 0; i != n; ++i) c[i & (len - 1)] += a[i];
+  forward(&c[0], len);
+  if (a == b && n == m) {
+    multiplyEach(&c[0], &c[0], &c[0], len);
+  } else {
+    std::vector<Value> d(len);
+    for (size_t i = 0; i != m; ++i) d[i & (len - 1)] += b[i];
+    forward(&d[0], len);
+    multiplyEach(&c[0], &d[0], &c[0], len);
+  }
+  inverse(&c[0], len);
+}
+
+template <uint32_t P> void
+NTT<P>::convolve(const Value *a, size_t n, const Value *b, size_t m,
+                 Value *c) {
+  if (n && m) middleProduct(a, n, b, m, 0, n + m - 1, c);
+}
+
+template <uint32_t P> void
+NTT<P>::middleProduct(const Value *a, size_t n, const Value *b, size_t m,
+                      size_t lo, size_t hi, Value *c) {
+  if (lo >= hi) return;
+  std::fill(c, c + (hi - lo), Value());
+  if (!n || !m || lo >= n + m - 1) return;
+  const size_t size = n + m - 1, end = std::min(hi, size);
+  // Term by term for the short ones.
+  if (std::min(n, m) <= 32) {
+    for (size_t j = lo; j != end; ++j) {
+      Value sum = Value();
+      for (size_t i = j < m ? 0 : j - m + 1; i <= j && i != n; ++i)
+        sum += a[i] * b[j - i];
+      c[j - lo] = sum;
+    }
+    return;
+  }
+  std::vector<Value> w;
+  const size_t len = length(size), half = len / 2, t = size - half;
+  if (!lo && end == size && half >= 64 && length(t * 2 - 1) <= half / 2) {
+    // w[i] = c[i] + c[i + half], and c[half, size) is the reversed
+    // low terms of the reversed a times the reversed b.
+    cyclic_(a, n, b, m, half, w);
+    const std::vector<Value> x(std::reverse_iterator<const Value *>(a + n),
+                               std::reverse_iterator<const Value *>(
+                                   a + n - std::min(t, n)));
+    const std::vector<Value> y(std::reverse_iterator<const Value *>(b + m),
+                               std::reverse_iterator<const Value *>(
+                                   b + m - std::min(t, m)));
+    std::vector<Value> top(t);
+    middleProduct(&x[0], x.size(), a == b && n == m ? &x[0] : &y[0],
+                  y.size(), 0, t, &top[0]);
+    for (size_t j = 0; j != t; ++j) c[half + j] = top[t - 1 - j];
+    for (size_t i = 0; i != half; ++i)
+      c[i] = i < t ? w[i] - c[half + i] : w[i];
+    return;
+  }
+  cyclic_(a, n, b, m, length(std::max(end, size - lo)), w);
+  std::copy(w.begin() + lo, w.begin() + end, c);
+}
@@ -0,0 +1,562 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>  // size_t
+#include <stdexcept>
+// cstdint is a C++11 header.
+#include <stdint.h>
+#include <vector>
+
+#include "NTT.hh"
+#include "Residue.hh"
+
+// Polynomials over a field R, meant for Residue<T, Mod> with a prime Mod:
+//   typedef Residue<int, 998244353> Z;
+//   Polynomial<Z> f(coefficients.begin(), coefficients.end());
+//   Polynomial<Z> g = f * f, h = (f - Z(1)).exp(n);  // exp(f - 1) mod x^n
+// The coefficients go from x^0 up, without trailing zeros, so the zero
+// polynomial has none. Residue multiplies by number theoretic transforms
+// (NTT, see NTT.hh) in O(n log n): modulo Mod itself if it is a prime with
+// 2^k | Mod - 1 for the length, else modulo three such primes, put back
+// together by the
+// Chinese remainder theorem, which is exact while min(n, m) (Mod - 1)^2 is
+// below their product of some 2^86. The inverse, division, square root,
+// logarithm and exponential are Newton's iterations over that, O(n log n)
+// as well, for n below Mod. Other R, and what is too long for the primes,
+// multiply in O(n^2).
+
+template <typename R> class Polynomial;
+
+template <typename R> Polynomial<R> &
+operator+=(Polynomial<R> &, const Polynomial<R> &);
+template <typename R> Polynomial<R> &
+operator-=(Polynomial<R> &, const Polynomial<R> &);
+template <typename R> Polynomial<R> &
+operator*=(Polynomial<R> &, const Polynomial<R> &);
+
+template <typename R> R
+polynomialPower_(R a, uint64_t expo, const R &one) {
+  R result = one;
+  for (; expo; expo >>= 1, a *= a)
+    if (expo & 1) result *= a;
+  return result;
+}
+
+// c[0, hi - lo) = (a[0, n) * b[0, m))[lo, hi), term by term, for
+// hi <= n + m - 1.
+template <typename R> void
+polynomialSchoolbook_(const R *a, size_t n, const R *b, size_t m,
+                      size_t lo, size_t hi, R *c) {
+  for (size_t j = lo; j != hi; ++j) {
+    R sum = R();
+    for (size_t i = j < m ? 0 : j - m + 1; i <= j && i != n; ++i)
+      sum += a[i] * b[j - i];
+    c[j - lo] = sum;
+  }
+}
+
+// How Polynomial multiplies its coefficients R, the terms [lo, hi) of the
+// product only, with n, m > 0 and lo < hi <= n + m - 1, and takes their
+// square roots: term by term, and only of 1, in general.
+template <typename R>
+struct PolynomialRing_ {
+  static R number(size_t n) { return R(n); }
+  static void multiply(const R *a, size_t n, const R *b, size_t m,
+                       size_t lo, size_t hi, R *c) {
+    polynomialSchoolbook_(a, n, b, m, lo, hi, c);
+  }
+  static bool sqrt(const R &c, R &root) {
+    root = c;
+    return c == R() || c == R(1);
+  }
+};
+
+template <typename T, T Mod>
+struct PolynomialRing_<Residue<T, Mod> > {
+  typedef Residue<T, Mod> R;
+  // 119 * 2^23 + 1, 5 * 2^25 + 1 and 7 * 2^26 + 1.
+  static const uint32_t P1 = 998244353u, P2 = 167772161u, P3 = 469762049u;
+  // Mod, if it may be an NTT prime at all.
+  static const uint32_t Direct =
+      Mod > T(2) && static_cast<uint64_t>(Mod) >> 32 == 0
+      ? static_cast<uint32_t>(Mod) : P1;
+
+  static R number(size_t n) {
+    const uint64_t mod = static_cast<uint64_t>(R::modulus());
+    return R(static_cast<T>(static_cast<uint64_t>(n) % mod));
+  }
+
+  static void multiply(const R *a, size_t n, const R *b, size_t m,
+                       size_t lo, size_t hi, R *c) {
+    const size_t len = NTT<P1>::length(std::max(hi, n + m - 1 - lo));
+    const uint64_t mod = static_cast<uint64_t>(R::modulus());
+    const long double bound =
+        static_cast<long double>(std::min(n, m)) * (mod - 1) * (mod - 1);
+    if (std::min(n, m) <= 32) {
+      polynomialSchoolbook_(a, n, b, m, lo, hi, c);
+    } else if (mod == Direct && NTT<Direct>::fits(len)) {
+      std::vector<Residue<uint32_t, Direct> > z;
+      product_(a, n, b, m, lo, hi, z);
+      for (size_t i = 0; i != hi - lo; ++i)
+        c[i] = R(static_cast<T>(z[i].residue()));
+    } else if (NTT<P1>::fits(len)
+               && bound < static_cast<long double>(P1) * P2 * P3) {
+      std::vector<Residue<uint32_t, P1> > z1;
+      std::vector<Residue<uint32_t, P2> > z2;
+      std::vector<Residue<uint32_t, P3> > z3;
+      product_(a, n, b, m, lo, hi, z1);
+      product_(a, n, b, m, lo, hi, z2);
+      product_(a, n, b, m, lo, hi, z3);
+      for (size_t i = 0; i != hi - lo; ++i)
+        c[i] = crt_(z1[i].residue(), z2[i].residue(), z3[i].residue(), mod);
+    } else {
+      polynomialSchoolbook_(a, n, b, m, lo, hi, c);
+    }
+  }
+
+  // The same modulo P, with the residues of the coefficients.
+  template <uint32_t P> static void
+  product_(const R *a, size_t n, const R *b, size_t m, size_t lo, size_t hi,
+           std::vector<Residue<uint32_t, P> > &c) {
+    typedef Residue<uint32_t, P> Z;
+    std::vector<Z> x(n), y(a == b && n == m ? 0 : m);
+    for (size_t i = 0; i != n; ++i)
+      x[i] = Z(static_cast<uint32_t>(
+          static_cast<uint64_t>(a[i].residue()) % P));
+    for (size_t i = 0; i != y.size(); ++i)
+      y[i] = Z(static_cast<uint32_t>(
+          static_cast<uint64_t>(b[i].residue()) % P));
+    c.resize(hi - lo);
+    NTT<P>::middleProduct(&x[0], n, y.empty() ? &x[0] : &y[0], m, lo, hi,
+                          &c[0]);
+  }
+
+  // x mod mod from x mod P1, P2 and P3: x = x12 + P1 P2 t with x12 < P1 P2
+  // from the first two (Garner's algorithm).
+  static R crt_(uint64_t r1, uint64_t r2, uint64_t r3, uint64_t mod) {
+    static const uint64_t inverse12 =
+        nttModPower_(P1 % P2, P2 - 2, P2);
+    static const uint64_t inverse123 =
+        nttModPower_(uint64_t(P1) * P2 % P3, P3 - 2, P3);
+    const uint64_t p12 = uint64_t(P1) * P2;
+    const uint64_t x12 = r1 + P1 * ((r2 + P2 - r1 % P2) % P2 * inverse12 % P2);
+    const uint64_t t = (r3 + P3 - x12 % P3) % P3 * inverse123 % P3;
+    const uint64_t low = x12 % mod;
+    const uint64_t high = residueMultiply_(p12 % mod, t % mod, mod);
+    return R(static_cast<T>(low >= mod - high ? low - (mod - high)
+                                              : low + high));
+  }
+
+  // Tonelli-Shanks, for a prime modulus.
+  static bool sqrt(const R &c, R &root) {
+    const uint64_t p = static_cast<uint64_t>(R::modulus());
+    const R one = number(1);
+    root = c;
+    if (c == R() || p == 2) return true;
+    if (polynomialPower_(c, (p - 1) / 2, one) != one) return false;
+    uint64_t q = p - 1;
+    int s = 0;
+    for (; q % 2 == 0; q /= 2) ++s;
+    R z = number(2);
+    while (polynomialPower_(z, (p - 1) / 2, one) == one) z += one;
+    R b = polynomialPower_(z, q, one), t = polynomialPower_(c, q, one);
+    root = polynomialPower_(c, (q + 1) / 2, one);
+    while (t != one) {
+      int i = 0;
+      for (R u = t; u != one; u *= u) ++i;
+      for (int j = i + 1; j < s; ++j) b *= b;
+      s = i;
+      root *= b;
+      b *= b;
+      t *= b;
+    }
+    return true;
+  }
+};
+
+template <typename R>
+class Polynomial {
+ public:
+  typedef R Value;
+
+  Polynomial();
+  Polynomial(const R &);
+  explicit Polynomial(const std::vector<R> &);
+  template <typename InputIter> Polynomial(InputIter, InputIter);
+
+  // The number of coefficients, 0 for the zero polynomial, so the degree
+  // is size() - 1.
+  size_t size() const;
+  const R &operator[](size_t) const;
+  const std::vector<R> &coefficients() const;
+  // f(x), by Horner's rule.
+  R operator()(const R &) const;
+
+  Polynomial operator-() const;
+  // f mod x^n.
+  Polynomial prefix(size_t) const;
+  Polynomial derivative() const;
+  Polynomial integral() const;
+  // g mod x^n with f g = 1, g^2 = f, g = log f, and g = exp f, mod x^n.
+  // Throw std::invalid_argument if f(0) is 0, if f has no square root,
+  // if f(0) is not 1, and if f(0) is not 0.
+  Polynomial inverse(size_t) const;
+  Polynomial sqrt(size_t) const;
+  Polynomial log(size_t) const;
+  Polynomial exp(size_t) const;
+
+  friend Polynomial &operator+=<>(Polynomial &, const Polynomial &);
+  friend Polynomial &operator-=<>(Polynomial &, const Polynomial &);
+  friend Polynomial &operator*=<>(Polynomial &, const Polynomial &);
+
+ private:
+  typedef PolynomialRing_<R> Ring_;
+
+  std::vector<R> value;
+
+  // f[0, n), padded with zeros.
+  std::vector<R> take_(size_t) const;
+  void trim_();
+};
+
+// (a[0, n) * b[0, m))[lo, hi), padded with zeros.
+template <typename R> std::vector<R>
+polynomialProduct_(const R *a, size_t n, const R *b, size_t m,
+                   size_t lo, size_t hi) {
+  std::vector<R> result(hi - lo);
+  n = std::min(n, hi), m = std::min(m, hi);
+  if (n && m && lo < n + m - 1)
+    PolynomialRing_<R>::multiply(a, n, b, m, lo, std::min(hi, n + m - 1),
+                                 &result[0]);
+  return result;
+}
+
+// 1 / 1, ..., 1 / n, from one inverse of n! and prefix products.
+template <typename R> std::vector<R>
+polynomialReciprocals_(size_t n) {
+  typedef PolynomialRing_<R> Ring;
+  std::vector<R> product(n + 1), result(n + 1);
+  product[0] = Ring::number(1);
+  for (size_t i = 1; i <= n; ++i) product[i] = product[i - 1] * Ring::number(i);
+  R inverse = Ring::number(1) / product[n];
+  for (size_t i = n; i; --i) {
+    result[i] = inverse * product[i - 1];
+    inverse *= Ring::number(i);
+  }
+  return result;
+}
+
+template <typename R>
+Polynomial<R>::Polynomial() {
+}
+
+template <typename R>
+Polynomial<R>::Polynomial(const R &value)
+    : value(1, value) {
+  this->trim_();
+}
+
+template <typename R>
+Polynomial<R>::Polynomial(const std::vector<R> &value)
+    : value(value) {
+  this->trim_();
+}
+
+template <typename R> template <typename InputIter>
+Polynomial<R>::Polynomial(InputIter begin, InputIter end)
+    : value(begin, end) {
+  this->trim_();
+}
+
+template <typename R> size_t
+Polynomial<R>::size() const {
+  return this->value.size();
+}
+
+template <typename R> const R &
+Polynomial<R>::operator[](size_t i) const {
+  return this->value[i];
+}
+
+template <typename R> const std::vector<R> &
+Polynomial<R>::coefficients() const {
+  return this->value;
+}
+
+template <typename R> R
+Polynomial<R>::operator()(const R &x) const {
+  R result = R();
+  for (size_t i = this->value.size(); i; --i)
+    result = result * x + this->value[i - 1];
+  return result;
+}
+
+template <typename R> Polynomial<R>
+Polynomial<R>::operator-() const {
+  Polynomial result;
+  return result -= *this;
+}
+
+template <typename R> Polynomial<R>
+Polynomial<R>::prefix(size_t n) const {
+  return Polynomial(this->take_(std::min(n, this->value.size())));
+}
+
+template <typename R> Polynomial<R>
+Polynomial<R>::derivative() const {
+  std::vector<R> result(this->value.empty() ? 0 : this->value.size() - 1);
+  for (size_t i = 0; i != result.size(); ++i)
+    result[i] = this->value[i + 1] * Ring_::number(i + 1);
+  return Polynomial(result);
+}
+
+template <typename R> Polynomial<R>
+Polynomial<R>::integral() const {
+  const size_t n = this->value.size();
+  const std::vector<R> reciprocal = polynomialReciprocals_<R>(n);
+  std::vector<R> result(n + 1);
+  for (size_t i = 0; i != n; ++i)
+    result[i + 1] = this->value[i] * reciprocal[i + 1];
+  return Polynomial(result);
+}
+
+// g = g - g (f g - 1), which doubles the terms right: f g - 1 is zero
+// below x^k, so only its terms from x^k on are computed, as a middle
+// product, and multiplied.
+template <typename R> Polynomial<R>
+Polynomial<R>::inverse(size_t n) const {
+  if (this->value.empty() || this->value[0] == R())
+    throw std::invalid_argument("inverse");
+  if (!n) return Polynomial();
+  const R one = Ring_::number(1);
+  std::vector<R> g(1, one / this->value[0]);
+  for (size_t k = 1; k < n; k = g.size()) {
+    const size_t next = std::min(k * 2, n);
+    const std::vector<R> e = polynomialProduct_(
+        &this->value[0], this->value.size(), &g[0], k, k, next);
+    const std::vector<R> d = polynomialProduct_(
+        &g[0], k, &e[0], next - k, 0, next - k);
+    g.resize(next);
+    for (size_t i = k; i != next; ++i) g[i] = R() - d[i - k];
+  }
+  return Polynomial(g);
+}
+
+// f = c x^2s h with h(0) = 1 has g = sqrt(c) x^s sqrt(h), and that is
+// g = (g + h / g) / 2.
+template <typename R> Polynomial<R>
+Polynomial<R>::sqrt(size_t n) const {
+  size_t s = 0;
+  while (s != this->value.size() && this->value[s] == R()) ++s;
+  if (s == this->value.size() || s / 2 >= n) return Polynomial();
+  R root;
+  if (s % 2 || !Ring_::sqrt(this->value[s], root))
+    throw std::invalid_argument("sqrt");
+  const R half = Ring_::number(1) / Ring_::number(2);
+  const size_t len = n - s / 2;
+  const std::vector<R> f(this->value.begin() + s, this->value.end());
+  std::vector<R> g(1, root);
+  for (size_t k = 1; k < len; k = g.size()) {
+    const size_t next = std::min(k * 2, len);
+    const Polynomial inverse = Polynomial(g).inverse(next);
+    const std::vector<R> t = polynomialProduct_(
+        &f[0], f.size(), &inverse.value[0], inverse.value.size(), 0, next);
+    g.resize(next);
+    for (size_t i = 0; i != next; ++i) g[i] = (g[i] + t[i]) * half;
+  }
+  g.insert(g.begin(), s / 2, R());
+  return Polynomial(g);
+}
+
+// log f is the integral of f' / f.
+template <typename R> Polynomial<R>
+Polynomial<R>::log(size_t n) const {
+  if (this->value.empty() || this->value[0] != Ring_::number(1))
+    throw std::invalid_argument("log");
+  if (n <= 1) return Polynomial();
+  const std::vector<R> d = this->derivative().take_(n - 1);
+  const Polynomial inverse = this->inverse(n - 1);
+  const std::vector<R> q = polynomialProduct_(
+      &d[0], d.size(), &inverse.value[0], inverse.value.size(), 0, n - 1);
+  const std::vector<R> reciprocal = polynomialReciprocals_<R>(n - 1);
+  std::vector<R> result(n);
+  for (size_t i = 0; i != n - 1; ++i)
+    result[i + 1] = q[i] * reciprocal[i + 1];
+  return Polynomial(result);
+}
+
+// g = g (1 - log g + f).
+template <typename R> Polynomial<R>
+Polynomial<R>::exp(size_t n) const {
+  if (!this->value.empty() && this->value[0] != R())
+    throw std::invalid_argument("exp");
+  if (!n) return Polynomial();
+  const R one = Ring_::number(1);
+  std::vector<R> g(1, one);
+  for (size_t k = 1; k < n; k = g.size()) {
+    const size_t next = std::min(k * 2, n);
+    const std::vector<R> l = Polynomial(g).log(next).take_(next);
+    std::vector<R> d = this->take_(next);
+    for (size_t i = 0; i != next; ++i) d[i] -= l[i];
+    d[0] += one;
+    g = polynomialProduct_(&g[0], g.size(), &d[0], next, 0, next);
+  }
+  return Polynomial(g);
+}
+
+template <typename R> std::vector<R>
+Polynomial<R>::take_(size_t n) const {
+  std::vector<R> result(n);
+  std::copy(this->value.begin(),
+            this->value.begin() + std::min(n, this->value.size()),
+            result.begin());
+  return result;
+}
+
+template <typename R> void
+Polynomial<R>::trim_() {
+  while (!this->value.empty() && this->value.back() == R())
+    this->value.pop_back();
+}
+
+template <typename R> Polynomial<R> &
+operator+=(Polynomial<R> &lhs, const Polynomial<R> &rhs) {
+  if (lhs.value.size() < rhs.value.size()) lhs.value.resize(rhs.value.size());
+  for (size_t i = 0; i != rhs.value.size(); ++i) lhs.value[i] += rhs.value[i];
+  lhs.trim_();
+  return lhs;
+}
+
+template <typename R> Polynomial<R> &
+operator-=(Polynomial<R> &lhs, const Polynomial<R> &rhs) {
+  if (lhs.value.size() < rhs.value.size()) lhs.value.resize(rhs.value.size());
+  for (size_t i = 0; i != rhs.value.size(); ++i) lhs.value[i] -= rhs.value[i];
+  lhs.trim_();
+  return lhs;
+}
+
+template <typename R> Polynomial<R> &
+operator*=(Polynomial<R> &lhs, const Polynomial<R> &rhs) {
+  const size_t n = lhs.value.size(), m = rhs.value.size();
+  if (!n || !m) {
+    lhs.value.clear();
+    return lhs;
+  }
+  std::vector<R> result(n + m - 1);
+  PolynomialRing_<R>::multiply(&lhs.value[0], n, &rhs.value[0], m,
+                               0, n + m - 1, &result[0]);
+  lhs.value.swap(result);
+  lhs.trim_();
+  return lhs;
+}
+
+// a = b q + r with deg r < deg b: the reversed q is the reversed a over
+// the reversed b, mod x^(deg a - deg b + 1).
+// Throws std::invalid_argument if b is zero.
+template <typename R> void
+divide(const Polynomial<R> &a, const Polynomial<R> &b,
+       Polynomial<R> &quotient, Polynomial<R> &remainder) {
+  const size_t n = a.size(), m = b.size();
+  if (!m) throw std::invalid_argument("divide");
+  if (n < m) {
+    remainder = a;
+    quotient = Polynomial<R>();
+    return;
+  }
+  const size_t k = n - m + 1;
+  const std::vector<R> &x = a.coefficients(), &y = b.coefficients();
+  const std::vector<R> reversedA(x.rbegin(), x.rbegin() + k);
+  const Polynomial<R> inverse =
+      Polynomial<R>(y.rbegin(), y.rend()).inverse(k);
+  std::vector<R> q = polynomialProduct_(
+      &reversedA[0], k, &inverse.coefficients()[0], inverse.size(), 0, k);
+  std::reverse(q.begin(), q.end());
+  std::vector<R> r = polynomialProduct_(&q[0], k, &y[0], m, 0, m - 1);
+  for (size_t i = 0; i != m - 1; ++i) r[i] = x[i] - r[i];
+  quotient = Polynomial<R>(q);
+  remainder = Polynomial<R>(r);
+}
+
+template <typename R> Polynomial<R> &
+operator/=(Polynomial<R> &lhs, const Polynomial<R> &rhs) {
+  Polynomial<R> remainder;
+  divide(lhs, rhs, lhs, remainder);
+  return lhs;
+}
+
+template <typename R> Polynomial<R> &
+operator%=(Polynomial<R> &lhs, const Polynomial<R> &rhs) {
+  Polynomial<R> quotient;
+  divide(lhs, rhs, quotient, lhs);
+  return lhs;
+}
+
+template <typename R> Polynomial<R>
+operator+(const Polynomial<R> &lhs, const Polynomial<R> &rhs) {
+  Polynomial<R> copy = lhs;
+  return copy += rhs;
+}
+
+template <typename R> Polynomial<R>
+operator+(const Polynomial<R> &lhs, const R &rhs) {
+  return lhs + Polynomial<R>(rhs);
+}
+
+template <typename R> Polynomial<R>
+operator+(const R &lhs, const Polynomial<R> &rhs) {
+  return Polynomial<R>(lhs) + rhs;
+}
+
+template <typename R> Polynomial<R>
+operator-(const Polynomial<R> &lhs, const Polynomial<R> &rhs) {
+  Polynomial<R> copy = lhs;
+  return copy -= rhs;
+}
+
+template <typename R> Polynomial<R>
+operator-(const Polynomial<R> &lhs, const R &rhs) {
+  return lhs - Polynomial<R>(rhs);
+}
+
+template <typename R> Polynomial<R>
+operator-(const R &lhs, const Polynomial<R> &rhs) {
+  return Polynomial<R>(lhs) - rhs;
+}
+
+template <typename R> Polynomial<R>
+operator*(const Polynomial<R> &lhs, const Polynomial<R> &rhs) {
+  Polynomial<R> copy = lhs;
+  return copy *= rhs;
+}
+
+template <typename R> Polynomial<R>
+operator*(const Polynomial<R> &lhs, const R &rhs) {
+  return lhs * Polynomial<R>(rhs);
+}
+
+template <typename R> Polynomial<R>
+operator*(const R &lhs, const Polynomial<R> &rhs) {
+  return Polynomial<R>(lhs) * rhs;
+}
+
+template <typename R> Polynomial<R>
+operator/(const Polynomial<R> &lhs, const Polynomial<R> &rhs) {
+  Polynomial<R> copy = lhs;
+  return copy /= rhs;
+}
+
+template <typename R> Polynomial<R>
+operator%(const Polynomial<R> &lhs, const Polynomial<R> &rhs) {
+  Polynomial<R> copy = lhs;
+  return copy %= rhs;
+}
+
+template <typename R> bool
+operator==(const Polynomial<R> &lhs, const Polynomial<R> &rhs) {
+  return lhs.coefficients() == rhs.coefficients();
+}
+
+template <typename R> bool
+operator!=(const Polynomial<R> &lhs, const Polynomial<R> &rhs) {
+  return !(lhs == rhs);
+}
@@ -1,10 +1,243 @@
 #pragma once
 
 #include "Euclid.hh"
+#include <algorithm>  // std::swap
 #include <iostream>  // std::istream, std::ostream
+// cstdint is a C++11 header.
+#include <stdint.h>
 
 template <typename T, T = 0> class Residue;
 
+// Residue<T> (Mod 0) takes its modulus from the calling thread, see
+// setResidueModulus below.
+#if __cplusplus >= 201103L
+#define RESIDUE_THREAD_LOCAL thread_local
+#elif defined(__GNUC__)
+#define RESIDUE_THREAD_LOCAL __thread
+#else
+#define RESIDUE_THREAD_LOCAL
+#endif  // __cplusplus >= 201103L
+
+// Mod^-1 mod 2^32 (or 2^64) for odd Mod by Newton's iteration, every step
+// of which doubles the correct low bits, from the 3 of Mod itself.
+template <typename Word, Word Mod, int Steps>
+struct MontgomeryInverse_ {
+  static const Word last = MontgomeryInverse_<Word, Mod, Steps - 1>::value;
+  static const Word value = last * (Word(2) - Mod * last);
+};
+
+template <typename Word, Word Mod>
+struct MontgomeryInverse_<Word, Mod, 0> {
+  static const Word value = Mod;
+};
+
+// x y mod m for x, y < m, which does not overflow for any m.
+inline uint64_t
+residueMultiply_(uint64_t x, uint64_t y, uint64_t m) {
+#if defined(__SIZEOF_INT128__)
+  return static_cast<uint64_t>(static_cast<unsigned __int128>(x) * y % m);
+#else
+  // Doubling and adding, where a + b >= m is tested as a >= m - b.
+  uint64_t result = 0;
+  for (; y; y >>= 1, x = x >= m - x ? x - (m - x) : x + x)
+    if (y & 1) result = result >= m - x ? result - (m - x) : result + x;
+  return result;
+#endif  // defined(__SIZEOF_INT128__)
+}
+
+// x^-1 mod m, i.e. v with v x = gcd(x, m) (mod m), by the extended
+// Euclid's algorithm with the coefficients kept mod m, so that nothing
+// is negative and any m fits.
+inline uint64_t
+residueInverse_(uint64_t x, uint64_t m) {
+  // a = u x and b = v x (mod m).
+  uint64_t a = x % m, b = m, u = 1 % m, v = 0;
+  while (a) {
+    const uint64_t q = b / a, t = residueMultiply_(q % m, u, m);
+    b -= q * a;
+    v = v >= t ? v - t : v + (m - t);
+    std::swap(a, b), std::swap(u, v);
+  }
+  return v;
+}
+
+// The forms of ResidueForm_ below, chosen from Mod at compile time.
+// Residue<T> is in the runtime form. An odd Mod (not 1) is kept in
+// Montgomery form, which multiplies without a division, with R = 2^32
+// below 2^32 and R = 2^64 above (with unsigned __int128). The others are
+// plain, multiplying in twice the width of T if Mod is above half of it,
+// where x * y would overflow T.
+enum ResidueKind_ {
+  ResiduePlain_, ResidueWide_, ResidueMontgomery_, ResidueMontgomery64_,
+  ResidueRuntime_
+};
+
+template <typename T, T Mod>
+struct ResidueKindOf_ {
+  static const ResidueKind_ value =
+      Mod == 0 ? ResidueRuntime_
+      : Mod <= T(1) ? ResiduePlain_
+      : Mod % 2 != 0 && static_cast<uint64_t>(Mod) >> 32 == 0
+      ? ResidueMontgomery_
+#if defined(__SIZEOF_INT128__)
+      : Mod % 2 != 0 ? ResidueMontgomery64_
+#endif  // defined(__SIZEOF_INT128__)
+      : static_cast<uint64_t>(Mod) >> (sizeof(T) * 4 - 1) != 0
+      ? ResidueWide_ : ResiduePlain_;
+};
+
+// How Residue<T, Mod> keeps its value. It is in [0, modulus()) for every
+// form, so that adding, subtracting and comparing are the same; in and out
+// convert from and to the residue itself, only to construct and for I/O.
+template <typename T, T Mod, ResidueKind_ = ResidueKindOf_<T, Mod>::value>
+struct ResidueForm_ {
+  static T modulus() { return Mod; }
+  static T in(const T &x) { return x; }
+  static T out(const T &x) { return x; }
+  static T multiply(T x, const T &y) {
+    x *= y;
+    x %= Mod;
+    return x;
+  }
+};
+
+// x is kept as x R mod Mod with R = 2^32, then x R * y R is reduced to
+// x y R by REDC: for t < Mod R, t R^-1 = (t - m Mod) / R with m = t Mod^-1
+// mod R, where the low words cancel out, so only the high ones subtract.
+template <typename T, T Mod>
+struct ResidueForm_<T, Mod, ResidueMontgomery_> {
+  static const uint32_t mod = static_cast<uint32_t>(Mod);
+  static const uint32_t inverse = MontgomeryInverse_<uint32_t, mod, 4>::value;
+  // R^2 mod Mod.
+  static const uint64_t square = ((uint64_t(1) << 32) % mod)
+                                 * ((uint64_t(1) << 32) % mod) % mod;
+
+  static T modulus() { return Mod; }
+  static T reduce(uint64_t t) {
+    const uint32_t m = static_cast<uint32_t>(t) * inverse;
+    const uint32_t high = static_cast<uint32_t>(t >> 32);
+    const uint32_t low = static_cast<uint32_t>((uint64_t(m) * mod) >> 32);
+    return static_cast<T>(high < low ? high - low + mod : high - low);
+  }
+  static T in(const T &x) { return reduce(static_cast<uint64_t>(x) * square); }
+  static T out(const T &x) { return reduce(static_cast<uint64_t>(x)); }
+  static T multiply(const T &x, const T &y) {
+    return reduce(static_cast<uint64_t>(x) * static_cast<uint64_t>(y));
+  }
+};
+
+#if defined(__SIZEOF_INT128__)
+// The same with R = 2^64, for the odd moduli up to 2^64, e.g. the 61-bit
+// primes of hashing.
+template <typename T, T Mod>
+struct ResidueForm_<T, Mod, ResidueMontgomery64_> {
+  typedef unsigned __int128 Wide;
+  static const uint64_t mod = static_cast<uint64_t>(Mod);
+  static const uint64_t inverse = MontgomeryInverse_<uint64_t, mod, 5>::value;
+  // R mod Mod, then R^2 mod Mod.
+  static const uint64_t r = (~uint64_t(0) % mod + 1) % mod;
+  static const uint64_t square = static_cast<uint64_t>(Wide(r) * r % mod);
+
+  static T modulus() { return Mod; }
+  static T reduce(Wide t) {
+    const uint64_t m = static_cast<uint64_t>(t) * inverse;
+    const uint64_t high = static_cast<uint64_t>(t >> 64);
+    const uint64_t low = static_cast<uint64_t>((Wide(m) * mod) >> 64);
+    return static_cast<T>(high < low ? high - low + mod : high - low);
+  }
+  static T in(const T &x) { return reduce(Wide(x) * square); }
+  static T out(const T &x) { return reduce(Wide(x)); }
+  static T multiply(const T &x, const T &y) {
+    return reduce(Wide(x) * static_cast<uint64_t>(y));
+  }
+};
+#endif  // defined(__SIZEOF_INT128__)
+
+template <typename T, T Mod>
+struct ResidueForm_<T, Mod, ResidueWide_> {
+  static T modulus() { return Mod; }
+  static T in(const T &x) { return x; }
+  static T out(const T &x) { return x; }
+  static T multiply(const T &x, const T &y) {
+    const uint64_t m = static_cast<uint64_t>(Mod);
+    return static_cast<T>(sizeof(T) <= 4
+        ? static_cast<uint64_t>(x) * static_cast<uint64_t>(y) % m
+        : residueMultiply_(x, y, m));
+  }
+};
+
+// The modulus of Residue<T> for each thread, and the factor
+// floor((2^64 - 1) / modulus) of its Barrett reduction.
+template <typename T>
+struct ResidueModulus_ {
+  static RESIDUE_THREAD_LOCAL T modulus;
+  static RESIDUE_THREAD_LOCAL uint64_t factor;
+};
+
+template <typename T> RESIDUE_THREAD_LOCAL T ResidueModulus_<T>::modulus;
+template <typename T> RESIDUE_THREAD_LOCAL uint64_t ResidueModulus_<T>::factor;
+
+// Sets the modulus of Residue<T> for the calling thread, which must be
+// done before a Residue<T> is made there. The Residue<T> made before keep
+// their values, but mean nothing with another modulus.
+template <typename T> void
+setResidueModulus(const T &modulus) {
+  ResidueModulus_<T>::modulus = modulus;
+  ResidueModulus_<T>::factor = ~uint64_t(0) / static_cast<uint64_t>(modulus);
+}
+
+template <typename T> T
+residueModulus() {
+  return ResidueModulus_<T>::modulus;
+}
+
+// Sets the modulus of Residue<T> for the calling thread for its lifetime,
+// to pass one explicitly to some code:
+//   ResidueModulusScope<long long> scope(p);
+template <typename T>
+class ResidueModulusScope {
+ public:
+  explicit ResidueModulusScope(const T &modulus)
+      : modulus_(ResidueModulus_<T>::modulus),
+        factor_(ResidueModulus_<T>::factor) {
+    setResidueModulus(modulus);
+  }
+  ~ResidueModulusScope() {
+    ResidueModulus_<T>::modulus = this->modulus_;
+    ResidueModulus_<T>::factor = this->factor_;
+  }
+
+ private:
+  T modulus_;
+  uint64_t factor_;
+
+  ResidueModulusScope(const ResidueModulusScope &);
+  ResidueModulusScope &operator=(const ResidueModulusScope &);
+};
+
+// x y mod m is x y - q m with q = floor(x y factor / 2^64), which is off
+// by at most one: two multiplies and a correction instead of a division.
+// A modulus of 2^32 or more takes residueMultiply_ instead.
+template <typename T, T Mod>
+struct ResidueForm_<T, Mod, ResidueRuntime_> {
+  static T modulus() { return ResidueModulus_<T>::modulus; }
+  static T in(const T &x) { return x; }
+  static T out(const T &x) { return x; }
+  static T multiply(const T &x, const T &y) {
+    const uint64_t m = static_cast<uint64_t>(ResidueModulus_<T>::modulus);
+    if (m >> 32) return static_cast<T>(residueMultiply_(x, y, m));
+    const uint64_t t = static_cast<uint64_t>(x) * static_cast<uint64_t>(y);
+#if defined(__SIZEOF_INT128__)
+    const uint64_t q = static_cast<uint64_t>(
+        static_cast<unsigned __int128>(t) * ResidueModulus_<T>::factor >> 64);
+    const uint64_t r = t - q * m;
+    return static_cast<T>(r >= m ? r - m : r);
+#else
+    return static_cast<T>(t % m);
+#endif  // defined(__SIZEOF_INT128__)
+  }
+};
+
 template <typename T, T Mod>
 std::ostream &operator<<(std::ostream &, const Residue<T, Mod> &);
 template <typename T, T Mod>
@@ -25,9 +258,12 @@ template <typename T, T Mod>
 class Residue {
  public:
   Residue();
-  Residue(const Residue &);
   Residue(const T &);
 
+  // The modulus, and the residue in [0, modulus()) this stands for.
+  static T modulus();
+  T residue() const;
+
   friend std::ostream &operator<<<>(std::ostream &, const Residue &);
   friend std::istream &operator>><>(std::istream &, Residue &);
   friend Residue &operator+=<>(Residue &, const Residue &);
@@ -37,6 +273,8 @@ class Residue {
   friend bool operator==<>(const Residue &, const Residue &);
 
  private:
+  typedef ResidueForm_<T, Mod> Form_;
+
   T value;
 };
 
@@ -47,34 +285,41 @@ Residue<T, Mod>::Residue()
 
 template <typename T, T Mod>
 Residue<T, Mod>::Residue(const T &value)
-    : value(value % Mod) {
+    : value(value % Form_::modulus()) {
   if (this->value < 0)
-    this->value += Mod;
+    this->value += Form_::modulus();
+  this->value = Form_::in(this->value);
 }
 
-template <typename T, T Mod>
-Residue<T, Mod>::Residue(const Residue &that)
-    : value(that.value) {
+template <typename T, T Mod> T
+Residue<T, Mod>::modulus() {
+  return Form_::modulus();
+}
+
+template <typename T, T Mod> T
+Residue<T, Mod>::residue() const {
+  return Form_::out(this->value);
 }
 
 template <typename T, T Mod> std::ostream &
 operator<<(std::ostream &os, const Residue<T, Mod> &self) {
-  return os << self.value;
+  return os << Residue<T, Mod>::Form_::out(self.value);
 }
 
 template <typename T, T Mod> std::istream &
 operator>>(std::istream &is, Residue<T, Mod> &self) {
-  is >> self.value;
-  self.value %= Mod;
-  if (self.value < 0)
-    self.value += Mod;
+  T value;
+  if (is >> value) self = Residue<T, Mod>(value);
   return is;
 }
 
 template <typename T, T Mod> Residue<T, Mod> &
 operator+=(Residue<T, Mod> &lhs, const Residue<T, Mod> &rhs) {
-  if ((lhs.value += rhs.value) >= Mod)
-    lhs.value -= Mod;
+  // Not lhs.value + rhs.value >= mod, which overflows for Mod above half
+  // of T.
+  const T mod = Residue<T, Mod>::Form_::modulus();
+  lhs.value = lhs.value >= mod - rhs.value ? lhs.value - (mod - rhs.value)
+                                           : lhs.value + rhs.value;
   return lhs;
 }
 
@@ -101,8 +346,10 @@ operator+(const T &lhs, const Residue<T, Mod> &rhs) {
 
 template <typename T, T Mod> Residue<T, Mod> &
 operator-=(Residue<T, Mod> &lhs, const Residue<T, Mod> &rhs) {
-  if ((lhs.value -= rhs.value) < 0)
-    lhs.value += Mod;
+  // Not (lhs.value -= rhs.value) < 0, which fails for unsigned T.
+  const T mod = Residue<T, Mod>::Form_::modulus();
+  lhs.value = lhs.value < rhs.value ? lhs.value - rhs.value + mod
+                                    : lhs.value - rhs.value;
   return lhs;
 }
 
@@ -129,8 +376,7 @@ operator-(const T &lhs, const Residue<T, Mod> &rhs) {
 
 template <typename T, T Mod> Residue<T, Mod> &
 operator*=(Residue<T, Mod> &lhs, const Residue<T, Mod> &rhs) {
-  lhs.value *= rhs.value;
-  lhs.value %= Mod;
+  lhs.value = Residue<T, Mod>::Form_::multiply(lhs.value, rhs.value);
   return lhs;
 }
 
@@ -157,8 +403,11 @@ operator*(const T &lhs, const Residue<T, Mod> &rhs) {
 
 template <typename T, T Mod> Residue<T, Mod> &
 operator/=(Residue<T, Mod> &lhs, const Residue<T, Mod> &rhs) {
-  lhs.value *= modinv(rhs.value, Mod);
-  lhs.value %= Mod;
+  typedef typename Residue<T, Mod>::Form_ Form;
+  const uint64_t inverse = residueInverse_(
+      static_cast<uint64_t>(Form::out(rhs.value)),
+      static_cast<uint64_t>(Form::modulus()));
+  lhs.value = Form::multiply(lhs.value, Form::in(static_cast<T>(inverse)));
   return lhs;
 }
 
@@ -205,10 +454,10 @@ operator!=(const Residue<T, Mod> &lhs, const Residue<T, Mod> &rhs) {
 
 template <typename T, T Mod> bool
 operator!=(const Residue<T, Mod> &lhs, const T &rhs) {
-  return !(lhs == Residue<T>(rhs));
+  return !(lhs == Residue<T, Mod>(rhs));
 }
 
 template <typename T, T Mod> bool
 operator!=(const T &lhs, const  Residue<T, Mod> &rhs) {
-  return !(Residue<T>(lhs) == rhs);
+  return !(Residue<T, Mod>(lhs) == rhs);
 }
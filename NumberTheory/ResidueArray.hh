@@ -0,0 +1,272 @@
+#pragma once
+
+#include <cstddef>  // size_t
+// cstdint is a C++11 header.
+#include <stdint.h>
+#if defined(__AVX2__) || defined(__AVX512F__)
+#include <immintrin.h>
+#endif
+
+#include "Residue.hh"
+
+// The same operation over whole arrays of Residue, for the long passes of
+// e.g. polynomial arithmetic:
+//   multiplyEach(x, y, z, n);  // z[i] = x[i] * y[i]
+//   addEach(x, y, z, n);       // z[i] = x[i] + y[i]
+//   subtractEach(x, y, z, n);  // z[i] = x[i] - y[i]
+//   scaleEach(a, x, z, n);     // z[i] = a * x[i]
+//   prefixProduct(x, z, n);    // z[i] = x[0] * ... * x[i]
+// z may be x or y, but must not overlap them otherwise. With AVX2 or
+// AVX-512, Residue<T, Mod> of a 32-bit T in Montgomery form (odd Mod below
+// 2^31) runs 8 or 16 lanes at a time; every other Residue loops over its
+// own operators.
+
+// The vector lanes of those, each a residue in [0, mod) in Montgomery
+// form. With mod below 2^31, x + y and x - y + mod do not overflow, and
+// the one of x + y, x + y - mod (x - y, x - y + mod) not wrapped around
+// is the smaller as unsigned.
+#if defined(__AVX512F__)
+struct ResidueLanes_ {
+  typedef __m512i Word;
+  static const size_t size = 16;
+
+  static Word load(const void *p) { return _mm512_loadu_si512(p); }
+  static void store(void *p, Word x) { _mm512_storeu_si512(p, x); }
+  static Word broadcast(uint32_t x) {
+    return _mm512_set1_epi32(static_cast<int>(x));
+  }
+  // GCC 12 warns that the unmasked forms of these (and of permutexvar
+  // below) read an uninitialized vector (its bug 105593). Zero-masking
+  // every lane compiles the same.
+  static Word min_(Word x, Word y) {
+    return _mm512_maskz_min_epu32(0xFFFF, x, y);
+  }
+  static Word mul_(Word x, Word y) {
+    return _mm512_maskz_mul_epu32(0xFF, x, y);
+  }
+  static Word high_(Word x) { return _mm512_maskz_srli_epi64(0xFF, x, 32); }
+
+  static Word add(Word x, Word y, Word mod) {
+    const Word s = _mm512_add_epi32(x, y);
+    return min_(s, _mm512_sub_epi32(s, mod));
+  }
+  static Word subtract(Word x, Word y, Word mod) {
+    const Word d = _mm512_sub_epi32(x, y);
+    return min_(d, _mm512_add_epi32(d, mod));
+  }
+  // REDC of ResidueForm_ in every lane: the even lanes multiply in place,
+  // the odd ones shifted down, and the high words blend back together.
+  static Word multiply(Word x, Word y, Word mod, Word inverse) {
+    const Word even = mul_(x, y);
+    const Word odd = mul_(high_(x), high_(y));
+    const Word lowEven = mul_(mul_(even, inverse), mod);
+    const Word lowOdd = mul_(mul_(odd, inverse), mod);
+    const Word high = _mm512_mask_blend_epi32(0xAAAA, high_(even), odd);
+    const Word low = _mm512_mask_blend_epi32(0xAAAA, high_(lowEven), lowOdd);
+    return subtract(high, low, mod);
+  }
+  // The products of the lanes up to each, by shifting up 1, 2, 4 and 8
+  // lanes, with one shifted in (kept by the mask of the permutation).
+  static Word scan(Word x, Word one, Word mod, Word inverse) {
+    x = multiply(x, _mm512_mask_permutexvar_epi32(one, 0xFFFE,
+        _mm512_setr_epi32(0, 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14),
+        x), mod, inverse);
+    x = multiply(x, _mm512_mask_permutexvar_epi32(one, 0xFFFC,
+        _mm512_setr_epi32(0, 0, 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13),
+        x), mod, inverse);
+    x = multiply(x, _mm512_mask_permutexvar_epi32(one, 0xFFF0,
+        _mm512_setr_epi32(0, 0, 0, 0, 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11),
+        x), mod, inverse);
+    return multiply(x, _mm512_mask_permutexvar_epi32(one, 0xFF00,
+        _mm512_setr_epi32(0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 2, 3, 4, 5, 6, 7),
+        x), mod, inverse);
+  }
+  static Word last(Word x) {
+    return _mm512_maskz_permutexvar_epi32(0xFFFF, _mm512_set1_epi32(15), x);
+  }
+};
+#elif defined(__AVX2__)
+struct ResidueLanes_ {
+  typedef __m256i Word;
+  static const size_t size = 8;
+
+  static Word load(const void *p) {
+    return _mm256_loadu_si256(static_cast<const __m256i *>(p));
+  }
+  static void store(void *p, Word x) {
+    _mm256_storeu_si256(static_cast<__m256i *>(p), x);
+  }
+  static Word broadcast(uint32_t x) {
+    return _mm256_set1_epi32(static_cast<int>(x));
+  }
+  static Word add(Word x, Word y, Word mod) {
+    const Word s = _mm256_add_epi32(x, y);
+    return _mm256_min_epu32(s, _mm256_sub_epi32(s, mod));
+  }
+  static Word subtract(Word x, Word y, Word mod) {
+    const Word d = _mm256_sub_epi32(x, y);
+    return _mm256_min_epu32(d, _mm256_add_epi32(d, mod));
+  }
+  static Word multiply(Word x, Word y, Word mod, Word inverse) {
+    const Word even = _mm256_mul_epu32(x, y);
+    const Word odd = _mm256_mul_epu32(_mm256_srli_epi64(x, 32),
+                                      _mm256_srli_epi64(y, 32));
+    const Word lowEven = _mm256_mul_epu32(_mm256_mul_epu32(even, inverse), mod);
+    const Word lowOdd = _mm256_mul_epu32(_mm256_mul_epu32(odd, inverse), mod);
+    const Word high = _mm256_blend_epi32(_mm256_srli_epi64(even, 32), odd,
+                                         0xAA);
+    const Word low = _mm256_blend_epi32(_mm256_srli_epi64(lowEven, 32), lowOdd,
+                                        0xAA);
+    return subtract(high, low, mod);
+  }
+  static Word scan(Word x, Word one, Word mod, Word inverse) {
+    x = multiply(x, _mm256_blend_epi32(_mm256_permutevar8x32_epi32(
+        x, _mm256_setr_epi32(0, 0, 1, 2, 3, 4, 5, 6)), one, 0x01),
+        mod, inverse);
+    x = multiply(x, _mm256_blend_epi32(_mm256_permutevar8x32_epi32(
+        x, _mm256_setr_epi32(0, 0, 0, 1, 2, 3, 4, 5)), one, 0x03),
+        mod, inverse);
+    return multiply(x, _mm256_blend_epi32(_mm256_permutevar8x32_epi32(
+        x, _mm256_setr_epi32(0, 0, 0, 0, 0, 1, 2, 3)), one, 0x0F),
+        mod, inverse);
+  }
+  static Word last(Word x) {
+    return _mm256_permutevar8x32_epi32(x, _mm256_set1_epi32(7));
+  }
+};
+#endif  // __AVX512F__, __AVX2__
+
+template <typename T, T Mod>
+struct ResidueLanesFit_ {
+#if defined(__AVX2__) || defined(__AVX512F__)
+  static const bool value =
+      sizeof(Residue<T, Mod>) == 4
+      && ResidueKindOf_<T, Mod>::value == ResidueMontgomery_
+      && static_cast<uint64_t>(Mod) >> 31 == 0;
+#else
+  static const bool value = false;
+#endif
+};
+
+template <typename T, T Mod, bool = ResidueLanesFit_<T, Mod>::value>
+struct ResidueArray_ {
+  typedef Residue<T, Mod> R;
+
+  static void multiply(const R *x, const R *y, R *z, size_t n) {
+    for (size_t i = 0; i != n; ++i) z[i] = x[i] * y[i];
+  }
+  static void add(const R *x, const R *y, R *z, size_t n) {
+    for (size_t i = 0; i != n; ++i) z[i] = x[i] + y[i];
+  }
+  static void subtract(const R *x, const R *y, R *z, size_t n) {
+    for (size_t i = 0; i != n; ++i) z[i] = x[i] - y[i];
+  }
+  static void scale(const R &a, const R *x, R *z, size_t n) {
+    const R f = a;
+    for (size_t i = 0; i != n; ++i) z[i] = f * x[i];
+  }
+  static void prefixProduct(const R *x, R *z, size_t n) {
+    if (!n) return;
+    z[0] = x[0];
+    for (size_t i = 1; i != n; ++i) z[i] = z[i - 1] * x[i];
+  }
+};
+
+// The lanes read and write the values of Residue in place, which is all
+// there is to it (a standard-layout class of one T). The tails are left
+// to the operators.
+#if defined(__AVX2__) || defined(__AVX512F__)
+template <typename T, T Mod>
+struct ResidueArray_<T, Mod, true> {
+  typedef Residue<T, Mod> R;
+  typedef ResidueForm_<T, Mod> Form;
+  typedef ResidueLanes_ Lanes;
+  typedef Lanes::Word Word;
+
+  static uint32_t raw(const R &x) {
+    return *reinterpret_cast<const uint32_t *>(&x);
+  }
+  static void multiply(const R *x, const R *y, R *z, size_t n) {
+    const Word mod = Lanes::broadcast(Form::mod);
+    const Word inverse = Lanes::broadcast(Form::inverse);
+    size_t i = 0;
+    for (; i + Lanes::size <= n; i += Lanes::size)
+      Lanes::store(z + i, Lanes::multiply(Lanes::load(x + i),
+                                          Lanes::load(y + i), mod, inverse));
+    for (; i != n; ++i) z[i] = x[i] * y[i];
+  }
+  static void add(const R *x, const R *y, R *z, size_t n) {
+    const Word mod = Lanes::broadcast(Form::mod);
+    size_t i = 0;
+    for (; i + Lanes::size <= n; i += Lanes::size)
+      Lanes::store(z + i, Lanes::add(Lanes::load(x + i),
+                                     Lanes::load(y + i), mod));
+    for (; i != n; ++i) z[i] = x[i] + y[i];
+  }
+  static void subtract(const R *x, const R *y, R *z, size_t n) {
+    const Word mod = Lanes::broadcast(Form::mod);
+    size_t i = 0;
+    for (; i + Lanes::size <= n; i += Lanes::size)
+      Lanes::store(z + i, Lanes::subtract(Lanes::load(x + i),
+                                          Lanes::load(y + i), mod));
+    for (; i != n; ++i) z[i] = x[i] - y[i];
+  }
+  static void scale(const R &a, const R *x, R *z, size_t n) {
+    const R f = a;
+    const Word mod = Lanes::broadcast(Form::mod);
+    const Word inverse = Lanes::broadcast(Form::inverse);
+    const Word g = Lanes::broadcast(raw(f));
+    size_t i = 0;
+    for (; i + Lanes::size <= n; i += Lanes::size)
+      Lanes::store(z + i, Lanes::multiply(g, Lanes::load(x + i),
+                                          mod, inverse));
+    for (; i != n; ++i) z[i] = f * x[i];
+  }
+  // Every block is scanned on its own, then multiplied by the product of
+  // all before, so only that multiply is on the critical path.
+  static void prefixProduct(const R *x, R *z, size_t n) {
+    const Word mod = Lanes::broadcast(Form::mod);
+    const Word inverse = Lanes::broadcast(Form::inverse);
+    const Word one = Lanes::broadcast(raw(R(T(1))));
+    Word carry = one;
+    size_t i = 0;
+    for (; i + Lanes::size <= n; i += Lanes::size) {
+      const Word block = Lanes::scan(Lanes::load(x + i), one, mod, inverse);
+      const Word product = Lanes::multiply(block, carry, mod, inverse);
+      Lanes::store(z + i, product);
+      carry = Lanes::last(product);
+    }
+    for (; i != n; ++i) z[i] = i ? z[i - 1] * x[i] : x[i];
+  }
+};
+#endif  // defined(__AVX2__) || defined(__AVX512F__)
+
+template <typename T, T Mod> void
+multiplyEach(const Residue<T, Mod> *x, const Residue<T, Mod> *y,
+             Residue<T, Mod> *z, size_t n) {
+  ResidueArray_<T, Mod>::multiply(x, y, z, n);
+}
+
+template <typename T, T Mod> void
+addEach(const Residue<T, Mod> *x, const Residue<T, Mod> *y,
+        Residue<T, Mod> *z, size_t n) {
+  ResidueArray_<T, Mod>::add(x, y, z, n);
+}
+
+template <typename T, T Mod> void
+subtractEach(const Residue<T, Mod> *x, const Residue<T, Mod> *y,
+             Residue<T, Mod> *z, size_t n) {
+  ResidueArray_<T, Mod>::subtract(x, y, z, n);
+}
+
+// a may be an element of x or z.
+template <typename T, T Mod> void
+scaleEach(const Residue<T, Mod> &a, const Residue<T, Mod> *x,
+          Residue<T, Mod> *z, size_t n) {
+  ResidueArray_<T, Mod>::scale(a, x, z, n);
+}
+
+template <typename T, T Mod> void
+prefixProduct(const Residue<T, Mod> *x, Residue<T, Mod> *z, size_t n) {
+  ResidueArray_<T, Mod>::prefixProduct(x, z, n);
+}
@@ -0,0 +1,58 @@
+// Regression checks for LinearAlgebra. It is a program on its own, any
+// standard from C++98 on:
+//   g++ -std=c++98 -O2 LinearAlgebra.cc -o check && ./check
+// A failed check aborts through assert.
+
+#include <cassert>
+#include <cstdio>
+
+#include "../LinearAlgebra/Matrix.hh"
+#include "../LinearAlgebra/VariableMatrix.hh"
+
+namespace {
+
+// triangularize_ flips the sign of the determinant only for the rows it
+// really swaps, not for every pivot.
+template <typename T>
+void checkDeterminantSign() {
+  const T identity[3][3] = {{1, 0, 0}, {0, 1, 0}, {0, 0, 1}};
+  const T swapped[3][3] = {{0, 2, 0}, {1, 0, 0}, {0, 0, 3}};
+  Matrix<T, 3, 3> a, b;
+  a.copyFromArray(identity), b.copyFromArray(swapped);
+  assert(a.determinant() == 1);
+  assert(b.determinant() == -6);
+  Matrix<T> c(3, 3), d(3, 3);
+  for (size_t i = 0; i != 3; ++i)
+    for (size_t j = 0; j != 3; ++j)
+      c[i][j] = identity[i][j], d[i][j] = swapped[i][j];
+  assert(c.determinant() == 1);
+  assert(d.determinant() == -6);
+}
+
+// A row of small entries is not zero to scaled partial pivoting, nor to
+// the rank.
+template <typename T>
+void checkSmallRow() {
+  const T small[2][2] = {{T(1e-9), T(2e-9)}, {3, 1}};
+  Matrix<T, 2, 2> a;
+  a.copyFromArray(small);
+  const T det = a.determinant(ScaledPartialPivot<T>());
+  assert(det < T(-4.9e-9) && det > T(-5.1e-9));
+  assert(a.rank() == 2);
+  Matrix<T> b(2, 2);
+  for (size_t i = 0; i != 2; ++i)
+    for (size_t j = 0; j != 2; ++j) b[i][j] = small[i][j];
+  assert(b.determinant(ScaledPartialPivot<T>()) == det);
+  assert(b.rank() == 2);
+}
+
+}  // namespace
+
+int main() {
+  checkDeterminantSign<double>();
+  checkDeterminantSign<long double>();
+  checkSmallRow<double>();
+  checkSmallRow<long double>();
+  std::puts("ok");
+  return 0;
+}
@@ -0,0 +1,53 @@
+// Regression checks for NumberTheory. It is a program on its own, any
+// standard from C++98 on:
+//   g++ -std=c++98 -O2 NumberTheory.cc -o check && ./check
+// A failed check aborts through assert.
+
+#include <cassert>
+#include <cstdio>
+#include <vector>
+
+#include "../NumberTheory/Polynomial.hh"
+#include "../NumberTheory/Residue.hh"
+
+namespace {
+
+typedef Residue<uint32_t, 998244353u> Z;
+
+// The root of c x^s h has the valuation s / 2, which may be below n even
+// if s is not.
+void checkPolynomialSqrt() {
+  std::vector<Z> f(5);
+  f[4] = Z(9u);
+  const Polynomial<Z> p(f);
+  for (size_t n = 1; n != 7; ++n) {
+    const Polynomial<Z> g = p.sqrt(n);
+    assert((g * g).prefix(n) == p.prefix(n));
+    if (n > 2) assert(g.size() == 3 && (g[2] == Z(3u) || g[2] == Z() - Z(3u)));
+    else assert(g.size() == 0);
+  }
+}
+
+// Division inverts without a signed type, so it works for any modulus up
+// to 2^64.
+template <typename T, T Mod>
+void checkResidueDivision() {
+  typedef Residue<T, Mod> R;
+  uint64_t seed = 88172645463325252ULL;
+  for (int i = 0; i != 1000; ++i) {
+    seed ^= seed << 13, seed ^= seed >> 7, seed ^= seed << 17;
+    const R x(static_cast<T>(seed % Mod));
+    const R y(static_cast<T>(seed / 3 % (Mod - 1) + 1));
+    assert(x / y * y == x);
+  }
+}
+
+}  // namespace
+
+int main() {
+  checkPolynomialSqrt();
+  checkResidueDivision<uint32_t, 4294967291u>();
+  checkResidueDivision<uint64_t, 18446744073709551557ULL>();
+  std::puts("ok");
+  return 0;
+}